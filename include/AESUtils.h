@@ -13,7 +13,7 @@
 #include <Definitions.h>
 
 namespace WhiteBox {
-enum class BlockCipherMode { ECB, CBC, CTR };
+enum class BlockCipherMode { ECB, CBC, CTR, GCM, XTS };
 
 enum class PaddingMode { NONE, ZEROS, PKCS, ONE_AND_ZEROS };
 /*!
@@ -23,6 +23,20 @@ enum class PaddingMode { NONE, ZEROS, PKCS, ONE_AND_ZEROS };
 constexpr std::array<uint8_t, NUM_ROUNDS_AES_128> AES_ROUND_CONSTANTS = {
     0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
 
+/*!
+ * \brief Byte i of the shift-rows output is byte SHIFT_ROWS_INDICES[i]
+ * of the input
+ */
+constexpr std::array<uint8_t, AES_BLOCK_SIZE_BYTES> SHIFT_ROWS_INDICES = {
+    0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11};
+
+/*!
+ * \brief Byte i of the inverse shift-rows output is byte
+ * INVERSE_SHIFT_ROWS_INDICES[i] of the input
+ */
+constexpr std::array<uint8_t, AES_BLOCK_SIZE_BYTES> INVERSE_SHIFT_ROWS_INDICES =
+    {0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3};
+
 /*!
  * \brief AES SBox, according to standard
  * see https://en.wikipedia.org/wiki/Rijndael_S-box
@@ -182,6 +196,15 @@ uint8_t galois_mul(uint8_t a, uint8_t b);
  * \return XOR result
  */
 State operator^(const State &lhs, const State &rhs);
+
+/*!
+ * \brief Add to a counter block, treating it as a 128-bit big-endian
+ * number that wraps around, like the counter of CTR mode
+ * \param counter counter block
+ * \param value number of blocks to advance the counter by
+ * \return the advanced counter block
+ */
+State add_to_counter(const State &counter, uint64_t value);
 }  // namespace WhiteBox
 
 #endif  // WHITEBOX_AES_UTILS_H_
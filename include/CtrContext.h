@@ -0,0 +1,104 @@
+#ifndef WHITEBOX_CTRCONTEXT_H_
+#define WHITEBOX_CTRCONTEXT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <WhiteBoxTableGenerator.h>
+
+namespace WhiteBox {
+// Keystream blocks a CtrContext keeps ready by default (4 KiB)
+constexpr size_t DEFAULT_CTR_LOOKAHEAD_BLOCKS = 256;
+
+/*!
+ * \brief AES-CTR keystream of one IV, computed ahead of use. A background
+ * thread runs the white box on the upcoming counter blocks and keeps up to
+ * the lookahead depth of keystream in a single-producer single-consumer
+ * ring buffer, so encrypting a short message is an XOR against keystream
+ * that is already there. The ring is lock-free; a mutex is only taken to
+ * wake the background thread once the ring has been full.
+ */
+class CtrContext {
+ public:
+  /*!
+   * \brief Start computing keystream
+   * \param data white box data used for encryption; has to outlive the
+   * context
+   * \param iv initial counter block, advanced as in apply_ctr_keystream
+   * \param lookahead_blocks number of keystream blocks to keep ready,
+   * rounded up to a power of two
+   */
+  CtrContext(const WhiteBoxData &data, const State &iv,
+             size_t lookahead_blocks = DEFAULT_CTR_LOOKAHEAD_BLOCKS);
+
+  /*!
+   * \brief Stop and join the background thread
+   */
+  ~CtrContext();
+
+  /*!
+   * \brief Encrypt or decrypt the next length bytes of the stream. Calls
+   * continue where the previous one stopped, also inside a block, so a
+   * stream split into any pieces gives the output of encrypt_ctr_mode.
+   * Waits for the background thread if the lookahead runs out. Must not be
+   * called from several threads at once.
+   * \param input data to be processed
+   * \param output result, may be the same as input
+   * \param length number of bytes
+   */
+  void process(const uint8_t *input, uint8_t *output, size_t length);
+
+  /*!
+   * \brief Number of bytes processed so far
+   */
+  uint64_t position() const;
+
+  /*!
+   * \brief Number of keystream blocks kept ready
+   */
+  size_t lookaheadBlocks() const;
+
+  CtrContext(const CtrContext &context) = delete;
+
+  CtrContext &operator=(const CtrContext &context) = delete;
+
+ private:
+  void producerLoop();
+
+  // Waits until keystream block number block is ready and returns it; the
+  // slot is not overwritten before the block is released
+  const State &readyBlock(uint64_t block);
+
+  // Hands the slots of all blocks before block back to the producer
+  void releaseBlocks(uint64_t block);
+
+  const WhiteBoxData &data_;
+  const State iv_;
+  std::vector<State> ring_;
+  const uint64_t mask_;
+
+  // Keystream blocks written by the producer and released by the consumer;
+  // block i lives in ring_[i & mask_]. Kept on separate cache lines, as
+  // each is written by a different thread.
+  alignas(64) std::atomic<uint64_t> produced_{0};
+  alignas(64) std::atomic<uint64_t> consumed_{0};
+
+  // Consumer state: the stream position and the last value of produced_
+  // it has seen
+  alignas(64) uint64_t position_ = 0;
+  uint64_t ready_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable spaceAvailable_;
+  std::atomic<bool> producerWaiting_{false};
+  std::atomic<bool> stopping_{false};
+
+  std::thread producer_;
+};
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_CTRCONTEXT_H_
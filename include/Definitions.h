@@ -8,16 +8,51 @@
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 
 namespace WhiteBox {
 constexpr int AES_KEY_LENGTH_BYTES = 16;
 constexpr int AES_BLOCK_SIZE_BYTES = 16;
 constexpr int NUM_ROUNDS_AES_128 = 10;
 constexpr int NUM_ROUND_KEYS_AES_128 = 11;
+// Rounds that are computed with Tyi, XOR and mixing tables; the last round
+// has no MixColumns and uses T-boxes only
+constexpr int NUM_TABLE_ROUNDS_AES_128 = NUM_ROUNDS_AES_128 - 1;
 constexpr int ROUND_XOR_TABLES = 96;
 
 constexpr size_t XOR_TABLE_OFFSET = 16 * 4;
 
+// Byte-wide XOR tables each replace two nibble XOR tables
+constexpr int ROUND_BYTE_XOR_TABLES = ROUND_XOR_TABLES / 2;
+constexpr size_t BYTE_XOR_TABLE_OFFSET = XOR_TABLE_OFFSET / 2;
+
+/*!
+ * \brief Width of the XOR tables: NIBBLE tables XOR two 4-bit values each,
+ * as in Chow's construction. BYTE tables XOR two bytes, so the XOR cascades
+ * need half the lookups, but each table has 64 KiB entries instead of 256.
+ */
+enum class TableGranularity { NIBBLE, BYTE };
+
+// Each table of WhiteBoxData starts on its own cache line. The tables are
+// multiples of this size, so they follow each other without gaps.
+constexpr size_t TABLE_SECTION_ALIGNMENT = 64;
+
+// Number of independent blocks the batch interpreter interleaves per round
+constexpr size_t INTERPRETER_BATCH_SIZE = 8;
+
+// Number of blocks the SSE4.1 interpreter keeps in one register per byte
+constexpr size_t SSE4_BATCH_SIZE = 4;
+
+// Number of blocks the AVX2 interpreter keeps in one register per byte
+constexpr size_t AVX2_BATCH_SIZE = 8;
+
+// Number of blocks the AVX-512 interpreter keeps in one register per byte
+constexpr size_t AVX512_BATCH_SIZE = 64;
+
+// Number of blocks callers hand to the batch interpreter at once, enough to
+// fill the widest backend
+constexpr size_t INTERPRETER_STAGING_BLOCKS = AVX512_BATCH_SIZE;
+
 typedef std::array<uint8_t, NUM_ROUND_KEYS_AES_128 * AES_KEY_LENGTH_BYTES>
     ExpandedKey;
 typedef std::array<uint8_t, AES_KEY_LENGTH_BYTES> State;
@@ -30,16 +65,33 @@ typedef std::array<RoundTBoxes, NUM_ROUNDS_AES_128> TBoxes;
 
 typedef std::array<uint32_t, std::numeric_limits<uint8_t>::max() + 1> TyiTable;
 typedef std::array<TyiTable, AES_KEY_LENGTH_BYTES> TyiTablesRound;
-typedef std::array<TyiTablesRound, NUM_ROUNDS_AES_128> TyiTables;
+typedef std::array<TyiTablesRound, NUM_TABLE_ROUNDS_AES_128> TyiTables;
 
 typedef std::array<uint8_t, std::numeric_limits<uint8_t>::max() + 1> XorTable;
 typedef std::array<XorTable, ROUND_XOR_TABLES> RoundXorTables;
-typedef std::array<RoundXorTables, NUM_ROUNDS_AES_128> XorTables;
+typedef std::array<RoundXorTables, NUM_TABLE_ROUNDS_AES_128> XorTables;
+
+// XOR tables only have 4-bit outputs, so two entries fit into one byte:
+// entry i is stored in the lower nibble of byte i / 2 if i is even,
+// in the upper nibble otherwise
+typedef std::array<uint8_t, (std::numeric_limits<uint8_t>::max() + 1) / 2>
+    PackedXorTable;
+typedef std::array<PackedXorTable, ROUND_XOR_TABLES> RoundPackedXorTables;
+typedef std::array<RoundPackedXorTables, NUM_TABLE_ROUNDS_AES_128>
+    PackedXorTables;
+
+// Entry (left << 8) | right holds the encoded XOR of the bytes left and
+// right; each nibble of it is what the corresponding nibble table holds
+typedef std::array<uint8_t, std::numeric_limits<uint16_t>::max() + 1>
+    ByteXorTable;
+typedef std::array<ByteXorTable, ROUND_BYTE_XOR_TABLES> RoundByteXorTables;
+typedef std::array<RoundByteXorTables, NUM_TABLE_ROUNDS_AES_128>
+    ByteXorTables;
 
 typedef std::array<uint32_t, std::numeric_limits<uint8_t>::max() + 1>
     MixingTable;
 typedef std::array<MixingTable, AES_KEY_LENGTH_BYTES> RoundMixingTables;
-typedef std::array<RoundMixingTables, NUM_ROUNDS_AES_128> MixingTables;
+typedef std::array<RoundMixingTables, NUM_TABLE_ROUNDS_AES_128> MixingTables;
 }  // namespace WhiteBox
 
 #endif  // WHITEBOX_DEFINITIONS_H_
@@ -0,0 +1,153 @@
+#ifndef WHITEBOX_GCMMODE_H_
+#define WHITEBOX_GCMMODE_H_
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+#include <ThreadPool.h>
+#include <WhiteBoxTableGenerator.h>
+
+namespace WhiteBox {
+constexpr size_t GCM_TAG_SIZE = 16;
+
+/*!
+ * \brief GHASH key H with the tables of the scalar multiplication: entry i
+ * holds H times the 4-bit polynomial i, in GCM's reflected bit order
+ */
+struct GhashKey {
+  /*!
+   * \brief Precompute the tables of H
+   * \param h hash subkey, E(0) for GCM
+   */
+  explicit GhashKey(const State &h);
+
+  State h_;
+  std::array<uint64_t, 16> high_;
+  std::array<uint64_t, 16> low_;
+};
+
+/*!
+ * \brief Whether the CPU supports PCLMULQDQ and SSSE3, which
+ * ghash_blocks_pclmul needs
+ */
+bool cpu_supports_pclmul();
+
+/*!
+ * \brief Hash whole blocks into a GHASH state: y = (y ^ block) * H for
+ * every block, with 4-bit table lookups. Works on every CPU.
+ * \param key hash key
+ * \param y GHASH state, updated in place
+ * \param blocks n blocks of 16 bytes
+ * \param n number of blocks
+ */
+void ghash_blocks_scalar(const GhashKey &key, State &y, const uint8_t *blocks,
+                         size_t n);
+
+/*!
+ * \brief ghash_blocks_scalar with carry-less multiplication. Must only be
+ * called if cpu_supports_pclmul() holds; on builds for other architectures
+ * this falls back to ghash_blocks_scalar.
+ * \param key hash key
+ * \param y GHASH state, updated in place
+ * \param blocks n blocks of 16 bytes
+ * \param n number of blocks
+ */
+void ghash_blocks_pclmul(const GhashKey &key, State &y, const uint8_t *blocks,
+                         size_t n);
+
+/*!
+ * \brief Hash whole blocks on the fastest kernel the CPU supports, see
+ * ghash_blocks_scalar
+ */
+void ghash_blocks(const GhashKey &key, State &y, const uint8_t *blocks,
+                  size_t n);
+
+/*!
+ * \brief Encrypt a buffer in AES-GCM mode. The keystream is the white box
+ * run in CTR mode, and GHASH runs over each piece of ciphertext right
+ * after it is produced, so the data is only passed over once.
+ * \param data white box data used for encryption
+ * \param iv initialization vector; 12 bytes are used as the counter
+ * prefix, other lengths are hashed into the first counter block
+ * \param iv_length length of the IV in bytes, at least 1
+ * \param aad additional authenticated data, may be nullptr if aad_length
+ * is 0
+ * \param aad_length length of the additional data
+ * \param input plaintext
+ * \param output ciphertext, may be the same as input
+ * \param length length of the plaintext, less than 2^36 - 32 bytes
+ * \param tag GCM_TAG_SIZE bytes for the authentication tag
+ */
+void encrypt_gcm(const WhiteBoxData &data, const uint8_t *iv,
+                 size_t iv_length, const uint8_t *aad, size_t aad_length,
+                 const uint8_t *input, uint8_t *output, size_t length,
+                 uint8_t *tag);
+
+/*!
+ * \brief Decrypt a buffer in AES-GCM mode and verify its tag in the same
+ * pass, see encrypt_gcm. If the tag does not match, the output is zeroed
+ * so that no unauthenticated plaintext is released.
+ * \param data white box data used for encryption
+ * \param iv initialization vector
+ * \param iv_length length of the IV in bytes, at least 1
+ * \param aad additional authenticated data
+ * \param aad_length length of the additional data
+ * \param input ciphertext
+ * \param output plaintext, may be the same as input
+ * \param length length of the ciphertext
+ * \param tag GCM_TAG_SIZE bytes of the expected tag
+ * \return whether the tag matches
+ */
+bool decrypt_gcm(const WhiteBoxData &data, const uint8_t *iv,
+                 size_t iv_length, const uint8_t *aad, size_t aad_length,
+                 const uint8_t *input, uint8_t *output, size_t length,
+                 const uint8_t *tag);
+
+/*!
+ * \brief Encrypt the given input stream in AES-GCM mode, reading it once.
+ * Windows of the input are split into chunks as in
+ * encrypt_ctr_mode_parallel; each task XORs the keystream onto its chunk
+ * and hashes the ciphertext while it is in cache. The chunk hashes are
+ * combined in order with powers of H. The tag is written after the
+ * ciphertext.
+ * \param input_stream the input data stream to be encrypted
+ * \param output_stream ciphertext followed by the tag
+ * \param data white box data used for encryption, shared by all threads
+ * \param iv initialization vector
+ * \param iv_length length of the IV in bytes, at least 1
+ * \param aad additional authenticated data
+ * \param aad_length length of the additional data
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void encrypt_gcm_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const uint8_t *iv,
+                      size_t iv_length, const uint8_t *aad, size_t aad_length,
+                      ThreadPool *pool);
+
+/*!
+ * \brief Decrypt the given input stream in AES-GCM mode, reading it once;
+ * the tag is taken from the end of the input and checked after the last
+ * chunk, see encrypt_gcm_mode. The last window is only written after the
+ * tag has been checked, so a message that fits into one window is never
+ * released unverified; the earlier windows of a longer stream are written
+ * as they are decrypted, before the tag is known.
+ * \throw CryptoPP::HashVerificationFilter::HashVerificationFailed if the
+ * tag does not match; anything already written has to be discarded then
+ * \throw CryptoPP::InvalidCiphertext if the input is shorter than a tag
+ * \param input_stream ciphertext followed by the tag
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for encryption, shared by all threads
+ * \param iv initialization vector
+ * \param iv_length length of the IV in bytes, at least 1
+ * \param aad additional authenticated data
+ * \param aad_length length of the additional data
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void decrypt_gcm_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const uint8_t *iv,
+                      size_t iv_length, const uint8_t *aad, size_t aad_length,
+                      ThreadPool *pool);
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_GCMMODE_H_
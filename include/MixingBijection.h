@@ -5,11 +5,11 @@
 #ifndef WHITEBOX_MIXINGBIJECTION_H_
 #define WHITEBOX_MIXINGBIJECTION_H_
 
+#include <array>
 #include <bitset>
+#include <string>
+#include <utility>
 
-#include <NTL/GF2.h>
-#include <NTL/mat_GF2.h>
-#include <NTL/vec_GF2.h>
 #include <cryptopp/osrng.h>
 
 #include <AESUtils.h>
@@ -19,6 +19,8 @@ namespace WhiteBox {
  * \brief This class defines mixing bijections. These are invertible
  * linear transformations that are used as a diffusion step in Chow's
  * AES white box scheme. They are invertible matrices over GF(2).
+ * Matrices are stored as one bit mask per row, bit j of row i being the
+ * entry (i, j); bit k of a value is entry k of the vector it represents.
  * \tparam T numerical data type which the mixing bijection can
  * transform; a uint32_t mixing bijection can transform
  * 32 bit integers, for example
@@ -26,31 +28,30 @@ namespace WhiteBox {
 template <typename T>
 class MixingBijection {
  public:
+  /*!
+   * \brief Size of the matrix in bits
+   */
+  static constexpr size_t SIZE = sizeof(T) * 8;
+
   /*!
    * \brief Construct a random mixing bijection of the given type
    * \param rng source of randomness
    */
-  explicit MixingBijection(CryptoPP::AutoSeededRandomPool &rng) : matrix() {
-    // Size in bits to construct matrix over GF2
-    constexpr size_t size = sizeof(T) * 8;
-    matrix.SetDims(size, size);
-
+  explicit MixingBijection(CryptoPP::AutoSeededRandomPool &rng)
+      : matrix(), inverse() {
     bool is_invertible = false;
 
     // Fill matrix until invertible
     while (!is_invertible) {
-      for (size_t i = 0; i < size; ++i) {
-        for (size_t j = 0; j < size; ++j) {
-          uint32_t random_bit = rng.GenerateBit();
-          matrix.put(i, j, random_bit);
+      for (size_t i = 0; i < SIZE; ++i) {
+        matrix[i] = 0;
+        for (size_t j = 0; j < SIZE; ++j) {
+          if (rng.GenerateBit() != 0) matrix[i] |= bit(j);
         }
       }
 
-      auto det = NTL::determinant(matrix);
-      if (det != 0) is_invertible = true;
+      is_invertible = invert(matrix, &inverse);
     }
-
-    inverse = NTL::inv(matrix);
   }
 
   /*!
@@ -58,18 +59,9 @@ class MixingBijection {
    * \param value either 0 or 1, as the bijections are
    * defined in GF(2).
    */
-  explicit MixingBijection(uint32_t value) {
-    constexpr size_t size = sizeof(T) * 8;
-    matrix.SetDims(size, size);
-
-    for (size_t i = 0; i < size; ++i) {
-      for (size_t j = 0; j < size; ++j) {
-        if (i == j) {
-          matrix.put(i, j, value);
-        } else {
-          matrix.put(i, j, 0);
-        }
-      }
+  explicit MixingBijection(uint32_t value) : matrix(), inverse() {
+    for (size_t i = 0; i < SIZE; ++i) {
+      matrix[i] = (value != 0) ? bit(i) : 0;
     }
 
     inverse = matrix;
@@ -114,27 +106,7 @@ class MixingBijection {
    * \return transformed value
    */
   T applyTransformation(const T &operand) const {
-    T return_value;
-
-    NTL::vec_GF2 v;
-    v.SetLength(sizeof(T) * 8);
-
-    for (size_t k = 0; k < sizeof(T) * 8; ++k) {
-      auto zero_at_pos = static_cast<uint32_t>((operand & (1U << k)) != 0U);
-      v.put(k, zero_at_pos);
-    }
-
-    v = matrix * v;
-
-    for (size_t k = 0; k < sizeof(T) * 8; ++k) {
-      if (v.at(k) == 1) {
-        return_value |= (1U << k);
-      } else {
-        return_value &= ~(1U << k);
-      }
-    }
-
-    return return_value;
+    return multiply(matrix, operand);
   }
 
   /*!
@@ -144,49 +116,7 @@ class MixingBijection {
    * \return transformed value
    */
   T applyInverseTransformation(const T &operand) const {
-    T return_value;
-
-    NTL::vec_GF2 v;
-    v.SetLength(sizeof(T) * 8);
-
-    for (size_t k = 0; k < sizeof(T) * 8; ++k) {
-      auto zero_at_pos = static_cast<T>((operand & (1 << k)) != 0U);
-      v.put(k, zero_at_pos);
-    }
-
-    v = inverse * v;
-
-    for (size_t k = 0; k < sizeof(T) * 8; ++k) {
-      if (v.at(k) == 1) {
-        return_value |= (1U << k);
-      } else {
-        return_value &= ~(1U << k);
-      }
-    }
-
-    return return_value;
-  }
-
-  /*!
-   * \brief Apply the inverse transformation given by this bijection
-   * to the input value
-   * \param operand input value, as bit vector
-   * \return transformed value
-   */
-  T applyInverseTransformation(const NTL::vec_GF2 &operand) const {
-    T return_value;
-
-    NTL::vec_GF2 v = inverse * operand;
-
-    for (size_t k = 0; k < sizeof(T) * 8; ++k) {
-      if (v.at(k) != 0) {
-        return_value |= (1U << k);
-      } else {
-        return_value &= ~(1U << k);
-      }
-    }
-
-    return return_value;
+    return multiply(inverse, operand);
   }
 
   /*!
@@ -219,16 +149,61 @@ class MixingBijection {
       const MixingBijection<uint8_t> &b3, const MixingBijection<uint8_t> &b4);
 
  private:
-  NTL::mat_GF2 matrix;
-  NTL::mat_GF2 inverse;
+  typedef std::array<T, SIZE> Matrix;
+
+  static constexpr T bit(size_t k) { return static_cast<T>(T(1) << k); }
+
+  // Bit i of the product is the parity of row i masked with the operand
+  static T multiply(const Matrix &m, T operand) {
+    T return_value = 0;
+    for (size_t i = 0; i < SIZE; ++i) {
+      if (__builtin_parity(static_cast<uint32_t>(m[i] & operand)) != 0)
+        return_value |= bit(i);
+    }
+    return return_value;
+  }
+
+  // Gauss-Jordan elimination of m next to the identity; returns false if m
+  // is singular, in which case the result is undefined
+  static bool invert(Matrix m, Matrix *result) {
+    Matrix &inv = *result;
+    for (size_t i = 0; i < SIZE; ++i) inv[i] = bit(i);
+
+    for (size_t col = 0; col < SIZE; ++col) {
+      size_t pivot = col;
+      while (pivot < SIZE && (m[pivot] & bit(col)) == 0) ++pivot;
+      if (pivot == SIZE) return false;
+
+      std::swap(m[col], m[pivot]);
+      std::swap(inv[col], inv[pivot]);
+      for (size_t row = 0; row < SIZE; ++row) {
+        if (row != col && (m[row] & bit(col)) != 0) {
+          m[row] ^= m[col];
+          inv[row] ^= inv[col];
+        }
+      }
+    }
+    return true;
+  }
+
+  Matrix matrix;
+  Matrix inverse;
 };
 
 template <typename T>
 std::ostream &operator<<(std::ostream &os, const MixingBijection<T> &mix) {
+  // Rows are printed with entry 0 first
+  auto print_matrix = [&os](const typename MixingBijection<T>::Matrix &m) {
+    for (const T &row : m) {
+      std::string bits = std::bitset<MixingBijection<T>::SIZE>(row).to_string();
+      os << std::string(bits.rbegin(), bits.rend()) << std::endl;
+    }
+  };
+
   os << "Mixing bijection: " << std::endl;
-  os << mix.matrix;
+  print_matrix(mix.matrix);
   os << "Inverse bijection: " << std::endl;
-  os << mix.inverse;
+  print_matrix(mix.inverse);
   os << std::endl;
   return os;
 }
@@ -0,0 +1,134 @@
+#ifndef WHITEBOX_PARALLELMODES_H_
+#define WHITEBOX_PARALLELMODES_H_
+
+#include <iostream>
+
+#include <cryptopp/filters.h>
+
+#include <ThreadPool.h>
+#include <WhiteBoxTableGenerator.h>
+
+namespace WhiteBox {
+// Bytes handed to one task at a time; a multiple of the block size
+constexpr size_t PARALLEL_CHUNK_SIZE = 64 * 1024;
+// Chunks read ahead per thread before the workers are started
+constexpr size_t PARALLEL_CHUNKS_PER_THREAD = 4;
+
+/*!
+ * \brief XOR the AES-CTR keystream onto a buffer
+ * \param data white box data used for encryption
+ * \param iv initial counter block
+ * \param first_block index of the block the buffer starts at; the
+ * counter of block i is iv + i
+ * \param buffer data to be encrypted or decrypted in place
+ * \param length length of the buffer, only the last block may be partial
+ */
+void apply_ctr_keystream(const WhiteBoxData &data, const State &iv,
+                         uint64_t first_block, uint8_t *buffer, size_t length);
+
+/*!
+ * \brief Encrypt the given input stream in AES-CTR mode on several
+ * threads. The input is read in chunks whose counters are derived from
+ * the IV and their offset, so chunks are processed independently; the
+ * output is written in order and equals that of encrypt_ctr_mode.
+ * \param input_stream the input data stream to be encrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for encryption, shared by all threads
+ * \param iv initialization vector
+ * \param pool threads to run on
+ */
+void encrypt_ctr_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data, const State &iv,
+                               ThreadPool &pool);
+
+/*!
+ * \brief Decrypt the given input stream in AES-CTR mode on several
+ * threads, see encrypt_ctr_mode_parallel
+ * \param input_stream the input data stream to be decrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for encryption, shared by all threads
+ * \param iv initialization vector
+ * \param pool threads to run on
+ */
+void decrypt_ctr_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data, const State &iv,
+                               ThreadPool &pool);
+
+/*!
+ * \brief Decrypt a byte range of an AES-CTR stream without processing what
+ * comes before it. The counter of the first block is derived from the
+ * offset and the input is seeked there, so the cost is proportional to the
+ * length of the range; start and end do not have to be block aligned.
+ * Input that cannot seek, like a pipe, is skipped by reading.
+ * \throw CryptoPP::InvalidArgument if the offset does not fit into a
+ * std::streamoff
+ * \param data white box data used for encryption
+ * \param iv initialization vector of the whole stream
+ * \param offset offset of the range in the stream, in bytes
+ * \param length length of the range; a range past the end of the input is
+ * cut off there
+ * \param input_stream the whole encrypted stream
+ * \param output_stream receives the decrypted range
+ * \param pool threads to run on; nullptr runs on the calling thread
+ * \return number of bytes written
+ */
+uint64_t decrypt_ctr_range(const WhiteBoxData &data, const State &iv,
+                           uint64_t offset, uint64_t length,
+                           std::istream &input_stream,
+                           std::ostream &output_stream, ThreadPool *pool);
+
+/*!
+ * \brief Encrypt the given input stream in AES-ECB mode on several threads.
+ * Padding is applied as by Crypto++'s StreamTransformationFilter, so the
+ * output equals that of encrypt_ecb_mode; the same exceptions are thrown
+ * for input it rejects.
+ * \param input_stream the input data stream to be encrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for encryption, shared by all threads
+ * \param padding_scheme padding scheme to use
+ * \param pool threads to run on
+ */
+void encrypt_ecb_mode_parallel(
+    std::istream &input_stream, std::ostream &output_stream,
+    const WhiteBoxData &data,
+    CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding_scheme,
+    ThreadPool &pool);
+
+/*!
+ * \brief Decrypt the given input stream in AES-ECB mode on several threads,
+ * see encrypt_ecb_mode_parallel
+ * \param input_stream the input data stream to be decrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for decryption, shared by all threads
+ * \param padding_scheme padding scheme to use
+ * \param pool threads to run on
+ */
+void decrypt_ecb_mode_parallel(
+    std::istream &input_stream, std::ostream &output_stream,
+    const WhiteBoxData &data,
+    CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding_scheme,
+    ThreadPool &pool);
+
+/*!
+ * \brief Decrypt the given input stream in AES-CBC mode on several threads.
+ * Each plaintext block only depends on two ciphertext blocks, so blocks
+ * are decrypted independently; padding is handled as in
+ * encrypt_ecb_mode_parallel. CBC encryption is inherently sequential and
+ * has no parallel counterpart.
+ * \param input_stream the input data stream to be decrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data used for decryption, shared by all threads
+ * \param iv initialization vector
+ * \param padding_scheme padding scheme to use
+ * \param pool threads to run on
+ */
+void decrypt_cbc_mode_parallel(
+    std::istream &input_stream, std::ostream &output_stream,
+    const WhiteBoxData &data, const State &iv,
+    CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding_scheme,
+    ThreadPool &pool);
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_PARALLELMODES_H_
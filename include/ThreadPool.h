@@ -0,0 +1,89 @@
+#ifndef WHITEBOX_THREADPOOL_H_
+#define WHITEBOX_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WhiteBox {
+/*!
+ * \brief Fixed set of worker threads running indexed tasks. The calling
+ * thread takes part in every run, so a pool of one thread runs
+ * everything on the caller.
+ */
+class ThreadPool {
+ public:
+  /*!
+   * \brief Start the workers
+   * \param num_threads number of threads tasks are run on, including the
+   * calling thread; 0 selects the number of hardware threads
+   */
+  explicit ThreadPool(size_t num_threads);
+
+  /*!
+   * \brief Stop and join the workers
+   */
+  ~ThreadPool();
+
+  /*!
+   * \brief Run task(0), ..., task(num_tasks - 1) on the pool and wait
+   * for all of them. Tasks are handed out in order, but may finish in any
+   * order. If tasks throw, the first exception is rethrown here after all
+   * tasks are done. Must not be called from inside a task.
+   * \param num_tasks number of tasks
+   * \param task function called with the task index
+   */
+  void parallelFor(size_t num_tasks, const std::function<void(size_t)> &task);
+
+  /*!
+   * \brief Run task once on every thread of the pool and wait for all of
+   * them, e.g. to warm up per-thread state. Exceptions are handled as in
+   * parallelFor. Must not be called from inside a task.
+   * \param task function called with the index of the thread, 0 for the
+   * calling thread up to numThreads() - 1
+   */
+  void runOnEachThread(const std::function<void(size_t)> &task);
+
+  /*!
+   * \brief Number of threads tasks are run on, including the caller
+   */
+  size_t numThreads() const;
+
+  ThreadPool(const ThreadPool &pool) = delete;
+
+  ThreadPool &operator=(const ThreadPool &pool) = delete;
+
+ private:
+  void workerLoop(size_t thread_index);
+
+  // Starts a run and takes part in it, see parallelFor
+  void run(size_t num_tasks, const std::function<void(size_t)> &task,
+           bool each_thread);
+
+  void runTasks(size_t thread_index);
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeWorkers_;
+  std::condition_variable workersDone_;
+
+  // State of the current run, guarded by mutex_ except for nextTask_
+  const std::function<void(size_t)> *task_ = nullptr;
+  size_t numTasks_ = 0;
+  // Whether every thread runs the task once instead of taking indices
+  bool eachThread_ = false;
+  std::atomic<size_t> nextTask_{0};
+  size_t busyWorkers_ = 0;
+  uint64_t run_ = 0;
+  std::exception_ptr exception_;
+  bool stopping_ = false;
+};
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_THREADPOOL_H_
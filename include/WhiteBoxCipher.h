@@ -7,6 +7,7 @@
 
 #include <cryptopp/seckey.h>
 
+#include <WhiteBoxInterpreter.h>
 #include <WhiteBoxTableGenerator.h>
 
 namespace WhiteBox {
@@ -34,6 +35,14 @@ class WhiteBoxCipher : public CryptoPP::FixedBlockSize<16>,
   void ProcessAndXorBlock(const byte *in_block, const byte *xor_block,
                           byte *out_block) const override;
 
+  // Processes whole spans of blocks through the batch interpreter; counter
+  // blocks (CTR) are incremented and XOR blocks applied as part of the pass
+  size_t AdvancedProcessBlocks(const byte *in_blocks, const byte *xor_blocks,
+                               byte *out_blocks, size_t length,
+                               CryptoPP::word32 flags) const override;
+
+  unsigned int OptimalNumberOfBlocksToProcessInParallel() const override;
+
   unsigned int BlockSize() const override;
 
   bool IsForwardTransformation() const override;
@@ -62,6 +71,8 @@ class WhiteBoxCipher : public CryptoPP::FixedBlockSize<16>,
  private:
   bool encrypt_;
   WhiteBoxData *tables_;
+  // Chosen once for the tables, used for every single block
+  WhiteBoxKernel kernel_;
 };
 }  // namespace WhiteBox
 
@@ -6,6 +6,7 @@
 #define WHITEBOX_WHITEBOX_INTERPRETER_H_
 
 #include <iostream>
+#include <string>
 
 #include <WhiteBoxTableGenerator.h>
 
@@ -22,6 +23,242 @@ namespace WhiteBox {
 State interpret_white_box(const WhiteBoxData &white_box_encryption_data,
                           const State& input_state, bool decrypt);
 
+/*!
+ * \brief Direction a specialized interpreter is compiled for
+ */
+enum class InterpreterDirection { ENCRYPT, DECRYPT };
+
+/*!
+ * \brief Passed to the interpreters in place of the XOR tables of tables
+ * with usesPlainXorTables_ set. Those tables compute the plain XOR, so the
+ * XOR cascades of a column reduce to XORing its four words directly.
+ */
+struct PlainXorTables {
+  constexpr PlainXorTables operator[](size_t) const { return {}; }
+};
+
+/*!
+ * \brief The shift-rows permutation of Direction as a compile-time
+ * constant, so that interpreters fold it into their state indexing
+ * instead of permuting the state
+ */
+template <InterpreterDirection Direction>
+constexpr const std::array<uint8_t, AES_BLOCK_SIZE_BYTES>
+    &shift_rows_indices() {
+  return (Direction == InterpreterDirection::DECRYPT)
+             ? INVERSE_SHIFT_ROWS_INDICES
+             : SHIFT_ROWS_INDICES;
+}
+
+/*!
+ * \brief interpret_white_box, specialized at compile time. The shift-rows
+ * permutation of Direction is a constant index table, the mixing step is
+ * compiled in or out depending on Mixing and all rounds are unrolled.
+ * Instantiated for all four combinations.
+ * \param white_box_encryption_data white box tables; usesMixingBijections_
+ * must match Mixing
+ * \param input_state Input state, i.e. the plain/ciphertext
+ * \return output state, i.e. plain/ciphertext
+ */
+template <InterpreterDirection Direction, bool Mixing>
+State interpret_white_box(const WhiteBoxData &white_box_encryption_data,
+                          const State &input_state);
+
+/*!
+ * \brief A specialization of interpret_white_box
+ */
+typedef State (*WhiteBoxKernel)(const WhiteBoxData &, const State &);
+
+/*!
+ * \brief Select the specialization of interpret_white_box matching the
+ * tables and direction, so that callers processing many blocks decide
+ * once instead of per block.
+ * \param white_box_encryption_data white box tables
+ * \param decrypt whether to encrypt or decrypt
+ * \return kernel to be called with the same tables
+ */
+WhiteBoxKernel select_white_box_kernel(
+    const WhiteBoxData &white_box_encryption_data, bool decrypt);
+
+/*!
+ * \brief Apply the encryption function given by the table to several
+ * independent blocks. Produces the same results as calling
+ * interpret_white_box on every block. Runs on the backend chosen by
+ * select_interpreter_backend; if none was chosen, the fastest one the CPU
+ * supports is selected on first use. Backends that work on fixed-size
+ * batches leave the remaining blocks to the next enabled one. Tables with
+ * byte XOR tables always run on the scalar interpreter, the only one that
+ * reads them, unless their XOR tables are plain.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param input_states n input states, i.e. the plain/ciphertexts
+ * \param output_states n output states; may be the same as input_states
+ * \param n number of blocks
+ * \param decrypt whether to encrypt or decrypt
+ * \param first_round round to start at; the input states are the states
+ * round first_round - 1 produced. 0, the default, runs all rounds on
+ * plain/ciphertexts.
+ */
+void interpret_white_box_batch(const WhiteBoxData &white_box_encryption_data,
+                               const State *input_states, State *output_states,
+                               size_t n, bool decrypt, size_t first_round = 0);
+
+/*!
+ * \brief Encrypt the AES-CTR counter blocks iv + first_block, ...,
+ * iv + first_block + n - 1, giving n blocks of keystream. Produces the same
+ * results as interpret_white_box_batch on the counter blocks, but memoizes
+ * round 0: counters that only differ in their last byte share all other
+ * round-0 inputs, so those results are computed once per run of 256
+ * counters and only the column the last byte is shifted into is redone per
+ * block. The remaining rounds run on the selected backend.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param iv initial counter block
+ * \param first_block index of the first block; the counter of block i is
+ * iv + i, as in apply_ctr_keystream
+ * \param output_states n keystream blocks
+ * \param n number of blocks
+ */
+void interpret_white_box_ctr(const WhiteBoxData &white_box_encryption_data,
+                             const State &iv, uint64_t first_block,
+                             State *output_states, size_t n);
+
+/*!
+ * \brief Implementations interpret_white_box_batch can run on
+ */
+enum class InterpreterBackend { AUTO, SCALAR, SSE4, AVX2, AVX512 };
+
+/*!
+ * \brief Parse a backend name: auto, scalar, sse4, avx2 or avx512
+ * \param backend result
+ * \param name name to parse
+ * \return whether the name is valid
+ */
+bool parse_interpreter_backend(InterpreterBackend &backend,
+                               const std::string &name);
+
+/*!
+ * \brief Name of a backend, as accepted by parse_interpreter_backend
+ */
+const char *interpreter_backend_name(InterpreterBackend backend);
+
+/*!
+ * \brief Choose the backend of interpret_white_box_batch. A backend is
+ * only enabled if the CPU supports it and it reproduces the scalar
+ * interpreter and a known-answer vector on freshly generated tables. AUTO
+ * takes the fastest enabled one. Not thread-safe; call this at startup,
+ * before blocks are processed.
+ * \param backend backend to use
+ * \return false if the backend is not usable on this CPU; the previous
+ * choice is kept then
+ */
+bool select_interpreter_backend(InterpreterBackend backend);
+
+/*!
+ * \brief Backend interpret_white_box_batch currently runs on
+ */
+InterpreterBackend active_interpreter_backend();
+
+/*!
+ * \brief interpret_white_box_batch on the scalar interpreter. Up to
+ * INTERPRETER_BATCH_SIZE blocks are processed round by round together, so
+ * that the table lookups of different blocks do not have to wait for each
+ * other. Works on every CPU.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param input_states n input states, i.e. the plain/ciphertexts
+ * \param output_states n output states; may be the same as input_states
+ * \param n number of blocks
+ * \param decrypt whether to encrypt or decrypt
+ * \param first_round round to start at, see interpret_white_box_batch
+ */
+void interpret_white_box_batch_scalar(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round = 0);
+
+// The SIMD backends below live in WhiteBoxInterpreter<ISA>.cpp, where
+// WHITEBOX_X86_SIMD marks GCC-compatible x86 builds. Only their functions
+// carry a target attribute for the instruction set they use; the rest of
+// the program is built for the baseline instruction set and calls them
+// only after the matching cpu_supports_* check. The PCLMULQDQ GHASH of
+// GcmMode.cpp is built the same way.
+
+/*!
+ * \brief Whether the CPU supports SSE4.1, which
+ * interpret_white_box_batch_sse4 needs
+ */
+bool cpu_supports_sse4();
+
+/*!
+ * \brief interpret_white_box_batch on SSE4.1. SSE4_BATCH_SIZE blocks are
+ * transposed as in interpret_white_box_batch_avx2; without gathers the
+ * lanes are looked up one by one, the index arithmetic is vectorized.
+ * Produces the same results as interpret_white_box. Must only be called if
+ * cpu_supports_sse4() holds; on builds for other architectures this falls
+ * back to interpret_white_box_batch_scalar.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param input_states n input states, i.e. the plain/ciphertexts
+ * \param output_states n output states; may be the same as input_states
+ * \param n number of blocks
+ * \param decrypt whether to encrypt or decrypt
+ * \param first_round round to start at, see interpret_white_box_batch
+ */
+void interpret_white_box_batch_sse4(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round = 0);
+
+/*!
+ * \brief Whether the CPU supports AVX2, which
+ * interpret_white_box_batch_avx2 needs
+ */
+bool cpu_supports_avx2();
+
+/*!
+ * \brief interpret_white_box_batch on AVX2. AVX2_BATCH_SIZE blocks are
+ * transposed so that every register holds the same byte of all blocks;
+ * table lookups are gathers over all blocks at once. Produces the same
+ * results as interpret_white_box. Must only be called if
+ * cpu_supports_avx2() holds; on builds for other architectures this falls
+ * back to interpret_white_box_batch_scalar.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param input_states n input states, i.e. the plain/ciphertexts
+ * \param output_states n output states; may be the same as input_states
+ * \param n number of blocks
+ * \param decrypt whether to encrypt or decrypt
+ * \param first_round round to start at, see interpret_white_box_batch
+ */
+void interpret_white_box_batch_avx2(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round = 0);
+
+/*!
+ * \brief Whether the CPU supports AVX-512 with VBMI, which
+ * interpret_white_box_batch_avx512 needs
+ */
+bool cpu_supports_avx512_vbmi();
+
+/*!
+ * \brief interpret_white_box_batch on AVX-512 VBMI. AVX512_BATCH_SIZE
+ * blocks are transposed into byte lanes; each XOR table is loaded into
+ * registers once per batch and looked up for all blocks with vpermi2b, the
+ * Tyi and mixing tables are read with gathers. Produces the same results as
+ * interpret_white_box. Must only be called if cpu_supports_avx512_vbmi()
+ * holds; on builds for other architectures this falls back to
+ * interpret_white_box_batch_scalar.
+ * \param white_box_encryption_data white box tables,
+ * calculated by the white box generator in this project.
+ * \param input_states n input states, i.e. the plain/ciphertexts
+ * \param output_states n output states; may be the same as input_states
+ * \param n number of blocks
+ * \param decrypt whether to encrypt or decrypt
+ * \param first_round round to start at, see interpret_white_box_batch
+ */
+void interpret_white_box_batch_avx512(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round = 0);
+
 /*!
  * \brief Calculate the first kind of XOR operation needed by the white box,
  * given the tables. For more details, see Chow's or Muir's paper;
@@ -0,0 +1,147 @@
+#ifndef WHITEBOX_WHITEBOXSTORAGE_H_
+#define WHITEBOX_WHITEBOXSTORAGE_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <ThreadPool.h>
+#include <WhiteBoxTableGenerator.h>
+
+namespace WhiteBox {
+constexpr std::array<char, 8> BINARY_TABLE_MAGIC = {'W', 'B', 'A', 'E',
+                                                    'S', 'T', 'B', 'L'};
+// Version 1 files, with a page-sized header and unused round slots, are
+// still read, but copied instead of being used in place
+constexpr uint32_t BINARY_TABLE_VERSION = 2;
+// Written in native byte order; a file from a machine with a different
+// byte order is rejected instead of being misread
+constexpr uint32_t BINARY_TABLE_BYTE_ORDER = 0x01020304;
+
+constexpr uint32_t BINARY_TABLE_FLAG_MIXING = 1U << 0U;
+// The tables were generated with TableGranularity::BYTE; the byte XOR
+// tables are derived from the stored nibble tables when loading
+constexpr uint32_t BINARY_TABLE_FLAG_BYTE_XOR_TABLES = 1U << 1U;
+// The tables were generated without internal encodings, see
+// WhiteBoxData::usesPlainXorTables_
+constexpr uint32_t BINARY_TABLE_FLAG_PLAIN_XOR_TABLES = 1U << 2U;
+
+// Size of the huge pages tables are placed on if requested
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// finalRoundTBoxes_, tyiTables_, xorTables_, mixingTables_, mixingXorTables_
+constexpr size_t BINARY_TABLE_SECTIONS = 5;
+
+struct BinaryTableSection {
+  uint64_t offset_;
+  uint64_t size_;
+};
+
+/*!
+ * \brief Header at the start of a binary table file. The rest of the file
+ * is an image of WhiteBoxData starting at dataOffset_, so that the file can
+ * be used in place after mapping it. The image ends with the last stored
+ * section; tables that are not used, such as the mixing tables of tables
+ * without mixing bijections, are stored with size 0 and left out.
+ */
+struct BinaryTableHeader {
+  std::array<char, 8> magic_;
+  uint32_t version_;
+  uint32_t byteOrder_;
+  uint32_t flags_;
+  uint32_t numSections_;
+  uint64_t dataOffset_;
+  uint64_t dataSize_;
+  // File offsets and sizes of the tables, in the order listed above
+  std::array<BinaryTableSection, BINARY_TABLE_SECTIONS> sections_;
+  // FNV-1a over all sections
+  uint64_t checksum_;
+};
+
+/*!
+ * \brief Releases white box data, either by unmapping the file or the
+ * pages it was mapped into or by deleting it if it was allocated
+ */
+struct WhiteBoxDataDeleter {
+  void *mapping_ = nullptr;
+  size_t mappingSize_ = 0;
+
+  void operator()(WhiteBoxData *data) const;
+};
+
+typedef std::unique_ptr<WhiteBoxData, WhiteBoxDataDeleter> WhiteBoxDataPtr;
+
+/*!
+ * \brief Allocate zero-initialized white box data, for instance to
+ * deserialize tables into
+ * \param huge_pages place the tables on HUGE_PAGE_SIZE pages, so that the
+ * lookups of the interpreter, which are spread over all of them, hit one or
+ * two TLB entries instead of hundreds. Reserved huge pages (MAP_HUGETLB)
+ * are used if there are any, otherwise the kernel is asked to back the
+ * memory with transparent huge pages (MADV_HUGEPAGE); if it does not, the
+ * data still works on regular pages.
+ * \return the data, or nullptr if no memory could be mapped
+ */
+WhiteBoxDataPtr allocate_white_box_data(bool huge_pages = false);
+
+/*!
+ * \brief Write the tables in the binary table format
+ * \param data tables to be written
+ * \param o stream to write to, should be opened in binary mode
+ * \return whether writing succeeded
+ */
+bool write_binary_table(const WhiteBoxData &data, std::ostream &o);
+
+/*!
+ * \brief Check whether the file at the given path starts with the
+ * magic of the binary table format
+ * \param path path of the table file
+ * \return true if it is a binary table file
+ */
+bool is_binary_table_file(const std::string &path);
+
+/*!
+ * \brief Map a binary table file into memory. The tables are used in
+ * place, without copying or parsing them; the mapping is private, so
+ * changes such as applying external encodings do not reach the file.
+ * Files of version 1 are copied into newly allocated data.
+ * \param path path of the table file
+ * \param huge_pages place the tables on huge pages as in
+ * allocate_white_box_data. Page cache pages of regular files cannot be
+ * huge, so the file is read into anonymous memory instead of being mapped.
+ * \return the tables, or nullptr if the file could not be mapped or is
+ * not a valid table file for this build; the reason is written to std::cerr
+ */
+WhiteBoxDataPtr map_binary_table(const std::string &path,
+                                 bool huge_pages = false);
+
+/*!
+ * \brief What warm does besides touching the table pages
+ */
+struct WarmOptions {
+  // Lock the table pages into memory with mlock
+  bool lock_ = false;
+  // Blocks run through interpret_white_box_batch per thread; their results
+  // are discarded
+  size_t dummyBlocks_ = 0;
+  // Threads the dummy blocks run on, the calling thread if nullptr
+  ThreadPool *pool_ = nullptr;
+};
+
+/*!
+ * \brief Prepare loaded tables for predictable latency: every page of the
+ * tables the interpreter reads is touched, so that the first blocks do not
+ * take page faults, which matters for mapped binary tables. The dummy
+ * blocks also load the tables into the caches of every thread and select
+ * the interpreter backend ahead of the first real block.
+ * \param data tables to prepare
+ * \param options locking and dummy blocks, none by default
+ * \return false if the pages could not be locked; the reason is written
+ * to std::cerr, everything else is still done
+ */
+bool warm(const WhiteBoxData &data, const WarmOptions &options = WarmOptions());
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_WHITEBOXSTORAGE_H_
@@ -10,10 +10,17 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/serialization/array.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
 
 #include <AESUtils.h>
 #include <MixingBijection.h>
 #include <RandomPermutation.h>
+#include <ThreadPool.h>
 
 namespace WhiteBox {
 /*!
@@ -26,36 +33,179 @@ struct WhiteBoxData {
   // Is this table protected with mixing bijections
   bool usesMixingBijections_;
 
+  // Derived by packXorTables(); if set, the interpreter reads the packed
+  // XOR tables instead of xorTables_/mixingXorTables_
+  bool usesPackedXorTables_ = false;
+
+  // Set for tables generated without internal encodings, whose XOR tables
+  // compute the plain XOR; the interpreter then XORs directly
+  bool usesPlainXorTables_ = false;
+
+  // With TableGranularity::BYTE, the interpreter reads the byte XOR tables,
+  // which widenXorTables() derives from xorTables_/mixingXorTables_; they
+  // are rebuilt on loading instead of being stored
+  TableGranularity xorGranularity_ = TableGranularity::NIBBLE;
+
+  // The tables follow each other in the order they are stored in. Tables
+  // that are not used (mixing tables without mixing bijections, packed
+  // tables until packXorTables(), byte tables until widenXorTables()) come
+  // last, are never written, read or serialized, and so never take up
+  // memory in mapped tables.
+
   // All the tables needed for the encryption/decryption
-  RoundTBoxes finalRoundTBoxes_;
-  TyiTables tyiTables_;
-  XorTables xorTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) RoundTBoxes finalRoundTBoxes_;
+  alignas(TABLE_SECTION_ALIGNMENT) TyiTables tyiTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) XorTables xorTables_;
 
   // Tables needed for mixing bijections
-  MixingTables mixingTables_;
-  XorTables mixingXorTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) MixingTables mixingTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) XorTables mixingXorTables_;
+
+  // Compact copies of the XOR tables
+  alignas(TABLE_SECTION_ALIGNMENT) PackedXorTables packedXorTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) PackedXorTables packedMixingXorTables_;
+
+  // Byte copies of the XOR tables, derived by widenXorTables(). They are
+  // part of WhiteBoxData so that they share its memory: huge pages, the
+  // mapping of a binary table file and what warm() touches and locks.
+  alignas(TABLE_SECTION_ALIGNMENT) ByteXorTables byteXorTables_;
+  alignas(TABLE_SECTION_ALIGNMENT) ByteXorTables byteMixingXorTables_;
 
+  // The SIMD interpreters read byte tables with 4-byte gathers, up to three
+  // bytes past the entry; this keeps those reads inside WhiteBoxData
+  std::array<uint8_t, 4> gatherPadding_;
+
+  /*!
+   * \brief Fill the packed XOR tables from the regular ones and make the
+   * interpreter use them. This halves the size of the XOR tables, which
+   * make up most of the tables touched per block.
+   */
+  void packXorTables() {
+    packXorTables(xorTables_, &packedXorTables_);
+    if (usesMixingBijections_)
+      packXorTables(mixingXorTables_, &packedMixingXorTables_);
+    usesPackedXorTables_ = true;
+  }
+
+  /*!
+   * \brief Fill the byte XOR tables from the nibble ones and make the
+   * interpreter use them. Each byte table does the work of two nibble
+   * tables, so the XOR cascades take half the lookups, at 27 MiB per set
+   * of XOR tables instead of 216 KiB.
+   */
+  void widenXorTables() {
+    widenXorTables(xorTables_, &byteXorTables_);
+    if (usesMixingBijections_)
+      widenXorTables(mixingXorTables_, &byteMixingXorTables_);
+    xorGranularity_ = TableGranularity::BYTE;
+  }
+
+  // Version 0 stored NUM_ROUNDS_AES_128 rounds of the round tables, the
+  // last one unused, and the mixing tables even without mixing bijections;
+  // version 2 added the granularity, version 3 usesPlainXorTables_
   template <class Archive>
-  void serialize(Archive &ar, const unsigned int version) {
+  void save(Archive &ar, const unsigned int version) const {
     ar &usesMixingBijections_;
+    ar &xorGranularity_;
+    ar &usesPlainXorTables_;
 
     ar &finalRoundTBoxes_;
     ar &tyiTables_;
     ar &xorTables_;
 
-    ar &mixingTables_;
-    ar &mixingXorTables_;
+    if (usesMixingBijections_) {
+      ar &mixingTables_;
+      ar &mixingXorTables_;
+    }
+  }
+
+  template <class Archive>
+  void load(Archive &ar, const unsigned int version) {
+    ar &usesMixingBijections_;
+    TableGranularity granularity = TableGranularity::NIBBLE;
+    if (version >= 2) ar &granularity;
+    usesPlainXorTables_ = false;
+    if (version >= 3) ar &usesPlainXorTables_;
+    usesPackedXorTables_ = false;
+
+    ar &finalRoundTBoxes_;
+    if (version == 0) {
+      loadLegacyRounds(ar, &tyiTables_);
+      loadLegacyRounds(ar, &xorTables_);
+      loadLegacyRounds(ar, &mixingTables_);
+      loadLegacyRounds(ar, &mixingXorTables_);
+    } else {
+      ar &tyiTables_;
+      ar &xorTables_;
+      if (usesMixingBijections_) {
+        ar &mixingTables_;
+        ar &mixingXorTables_;
+      }
+    }
+
+    xorGranularity_ = TableGranularity::NIBBLE;
+    if (granularity == TableGranularity::BYTE) widenXorTables();
+  }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  template <class Archive, typename Tables>
+  static void loadLegacyRounds(Archive &ar, Tables *tables) {
+    typedef std::array<typename Tables::value_type, NUM_ROUNDS_AES_128>
+        LegacyTables;
+    std::unique_ptr<LegacyTables> legacy_tables(new LegacyTables);
+    ar &*legacy_tables;
+    std::copy_n(legacy_tables->begin(), tables->size(), tables->begin());
+  }
+
+  static void packXorTables(const XorTables &xor_tables,
+                            PackedXorTables *packed_xor_tables) {
+    for (size_t i = 0; i < xor_tables.size(); ++i) {
+      for (size_t j = 0; j < xor_tables[i].size(); ++j) {
+        for (size_t k = 0; k < (*packed_xor_tables)[i][j].size(); ++k) {
+          (*packed_xor_tables)[i][j][k] = static_cast<uint8_t>(
+              (xor_tables[i][j][2 * k] & 0xFU) |
+              ((xor_tables[i][j][2 * k + 1] & 0xFU) << 4U));
+        }
+      }
+    }
+  }
+
+  static void widenXorTables(const XorTables &xor_tables,
+                             ByteXorTables *byte_xor_tables) {
+    for (size_t i = 0; i < xor_tables.size(); ++i) {
+      for (size_t j = 0; j < (*byte_xor_tables)[i].size(); ++j) {
+        // Nibble table 2 * j XORs the upper nibbles, 2 * j + 1 the lower
+        const XorTable &upper = xor_tables[i][2 * j];
+        const XorTable &lower = xor_tables[i][2 * j + 1];
+        ByteXorTable &table = (*byte_xor_tables)[i][j];
+        for (uint32_t left = 0; left < 256; ++left) {
+          for (uint32_t right = 0; right < 256; ++right) {
+            table[(left << 8U) | right] = static_cast<uint8_t>(
+                ((upper[(left & 0xF0U) | (right >> 4U)] & 0xFU) << 4U) |
+                (lower[((left & 0xFU) << 4U) | (right & 0xFU)] & 0xFU));
+          }
+        }
+      }
+    }
   }
 
   void serializeDefinition(std::ostream& o) const {
+    const int rounds = NUM_TABLE_ROUNDS_AES_128;
     o << "#include <array>\n\n";
     o << "struct WhiteBoxData {\n";
     o << "\tbool usesMixingBijections_;\n";
     o << "\tstd::array<std::array<uint8_t, 256>, 16> finalRoundTBoxes_;\n";
-    o << "\tstd::array<std::array<std::array<uint32_t, 256>, 16>, 10> tyiTables_;\n";
-    o << "\tstd::array<std::array<std::array<uint8_t, 256>, 96>, 10> xorTables_;\n";
-    o << "\tstd::array<std::array<std::array<uint32_t, 256>, 16>, 10> mixingTables_;\n";
-    o << "\tstd::array<std::array<std::array<uint8_t, 256>, 96>, 10> mixingXorTables_;\n";
+    o << "\tstd::array<std::array<std::array<uint32_t, 256>, 16>, " << rounds
+      << "> tyiTables_;\n";
+    o << "\tstd::array<std::array<std::array<uint8_t, 256>, 96>, " << rounds
+      << "> xorTables_;\n";
+    if (usesMixingBijections_) {
+      o << "\tstd::array<std::array<std::array<uint32_t, 256>, 16>, "
+        << rounds << "> mixingTables_;\n";
+      o << "\tstd::array<std::array<std::array<uint8_t, 256>, 96>, "
+        << rounds << "> mixingXorTables_;\n";
+    }
     o << "};\n\n";
   }
 
@@ -69,8 +219,10 @@ struct WhiteBoxData {
     serializeTBoxes(o);
     serializeTyiTables(o);
     serializeXorTables(o);
-    serializeMixingTables(o);
-    serializeMixingXorTables(o);
+    if (usesMixingBijections_) {
+      serializeMixingTables(o);
+      serializeMixingXorTables(o);
+    }
     o << "};\n";
   }
 
@@ -193,6 +345,11 @@ struct WhiteBoxData {
   }
 };
 
+/*!
+ * \brief Which tables a WhiteBoxTableGenerator creates
+ */
+enum class TableDirection { ENCRYPTION, DECRYPTION, BOTH };
+
 /*!
  * \brief This class manages the creation of tables needed
  * for the white-box crypto scheme. All the calculations happen here.
@@ -208,22 +365,34 @@ class WhiteBoxTableGenerator {
    * default true, required for security
    * \param use_mixing_bijections whether to use mixing bijections,
    * default true, required for security
+   * \param direction tables to create; the getter of a direction that
+   * was not created returns nullptr
+   * \param pool if given, rounds and directions are generated in parallel
+   * on it; randomness is still drawn on the calling thread
+   * \param granularity width of the XOR tables the returned data is
+   * interpreted with; BYTE trades 27 MiB per set of XOR tables for half
+   * the lookups
    */
-  explicit WhiteBoxTableGenerator(State aes_key,
-                                  bool use_internal_encoding = true,
-                                  bool use_mixing_bijections = true);
+  explicit WhiteBoxTableGenerator(
+      State aes_key, bool use_internal_encoding = true,
+      bool use_mixing_bijections = true,
+      TableDirection direction = TableDirection::BOTH,
+      ThreadPool *pool = nullptr,
+      TableGranularity granularity = TableGranularity::NIBBLE);
 
   /*!
    * \brief Get the encryption table, which can be used to encrypt data
    * This returns a pointer that was allocated on the heap.
-   * \return pointer to the data
+   * \return pointer to the data, nullptr if encryption tables were not
+   * created
    */
   WhiteBoxData *getEncryptionTable() const;
 
   /*!
    * \brief Get the decryption table, which can be used to decrypt data
    * This returns a pointer that was allocated on the heap.
-   * \return pointer to the data
+   * \return pointer to the data, nullptr if decryption tables were not
+   * created
    */
   WhiteBoxData *getDecryptionTable() const;
 
@@ -236,8 +405,44 @@ class WhiteBoxTableGenerator {
  private:
   std::array<uint8_t, AES_KEY_LENGTH_BYTES> aesKey_;
   ExpandedKey expandedAesKey_;
+  bool usesInternalEncodings_;
   bool usesMixingBijections_;
+  TableGranularity granularity_;
   CryptoPP::AutoSeededRandomPool rng;
+  ThreadPool *pool_;
+  // Directions that are created, false for encryption, true for decryption.
+  // Tables of the other direction are never written, so their pages are
+  // not touched.
+  std::vector<bool> directions_;
+
+  // Mixing bijections of one round
+  struct RoundMixingBijections {
+    // Applied to the Tyi table outputs of the round
+    std::vector<MixingBijection<uint32_t>> bijections32_;
+    // Applied to the round output, removed by the next round's Tyi tables
+    std::vector<MixingBijection<uint8_t>> bijections8_;
+    std::vector<MixingBijection<uint32_t>> bijections8Concat_;
+  };
+
+  // Internal encodings of one round; the output encodings of the last XOR
+  // cascade are the input encodings of the next round
+  struct RoundEncodings {
+    std::vector<RandomPermutation<uint8_t>> tyiOutput_;
+    std::vector<RandomPermutation<uint8_t>> xor1Output_;
+    std::vector<RandomPermutation<uint8_t>> xor2Output_;
+    std::vector<RandomPermutation<uint8_t>> mixingTableOutput_;
+    std::vector<RandomPermutation<uint8_t>> xor3Output_;
+    std::vector<RandomPermutation<uint8_t>> xor4Output_;
+
+    const std::vector<RandomPermutation<uint8_t>> &output() const {
+      return (xor4Output_.empty()) ? xor2Output_ : xor4Output_;
+    }
+  };
+
+  bool hasDirection(bool decryption) const;
+
+  // Run task(0), ..., task(num_tasks - 1), on the pool if there is one
+  void runTasks(size_t num_tasks, const std::function<void(size_t)> &task);
 
   TBoxes calculateTBoxes();
 
@@ -249,9 +454,16 @@ class WhiteBoxTableGenerator {
 
   void calculateMixingBijections();
 
+  void drawRoundMixingBijections(RoundMixingBijections *bijections);
+
   void calculateInternalEncodings();
 
-  void calculateInternalEncodingsWithMixingBijections();
+  void drawRoundEncodings(RoundEncodings *encodings);
+
+  void encodeRound(
+      size_t round, bool decryption,
+      const std::vector<RandomPermutation<uint8_t>> &input_encodings,
+      const RoundEncodings &encodings);
 
   void encodeTyiTables(
       size_t round,
@@ -329,4 +541,6 @@ class WhiteBoxTableGenerator {
 };
 }  // namespace WhiteBox
 
+BOOST_CLASS_VERSION(WhiteBox::WhiteBoxData, 3)
+
 #endif  // WHITEBOX_WHITEBOX_TABLE_GENERATOR_H_
@@ -0,0 +1,89 @@
+#ifndef WHITEBOX_XTSMODE_H_
+#define WHITEBOX_XTSMODE_H_
+
+#include <cstdint>
+#include <iostream>
+
+#include <ThreadPool.h>
+#include <WhiteBoxTableGenerator.h>
+
+namespace WhiteBox {
+// Bytes per sector (XTS data unit) if none is given
+constexpr size_t DEFAULT_XTS_SECTOR_SIZE = 512;
+
+/*!
+ * \brief Encrypt consecutive sectors in AES-XTS mode (IEEE 1619). Every
+ * sector is encrypted on its own, with the tweak key encrypting its sector
+ * number, so the sectors are spread over the pool and any sector can be
+ * rewritten in place without touching its neighbours. A sector whose
+ * length is not a multiple of the block size uses ciphertext stealing.
+ * \param data white box data of the data key, for encryption
+ * \param tweak_data white box data of the tweak key, for encryption
+ * \param first_sector sector number of the first sector of the buffer
+ * \param sector_size bytes per sector, at least AES_BLOCK_SIZE_BYTES
+ * \param input plaintext
+ * \param output ciphertext, may be the same as input
+ * \param length length of the buffer; only the last sector may be
+ * shorter, but not shorter than a block
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void encrypt_xts_sectors(const WhiteBoxData &data,
+                         const WhiteBoxData &tweak_data, uint64_t first_sector,
+                         size_t sector_size, const uint8_t *input,
+                         uint8_t *output, size_t length, ThreadPool *pool);
+
+/*!
+ * \brief Decrypt consecutive sectors in AES-XTS mode, see
+ * encrypt_xts_sectors
+ * \param data white box data of the data key, for decryption
+ * \param tweak_data white box data of the tweak key, for encryption as
+ * the tweak is always encrypted
+ * \param first_sector sector number of the first sector of the buffer
+ * \param sector_size bytes per sector, at least AES_BLOCK_SIZE_BYTES
+ * \param input ciphertext
+ * \param output plaintext, may be the same as input
+ * \param length length of the buffer, see encrypt_xts_sectors
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void decrypt_xts_sectors(const WhiteBoxData &data,
+                         const WhiteBoxData &tweak_data, uint64_t first_sector,
+                         size_t sector_size, const uint8_t *input,
+                         uint8_t *output, size_t length, ThreadPool *pool);
+
+/*!
+ * \brief Encrypt the given input stream in AES-XTS mode, as sectors
+ * numbered from first_sector, see encrypt_xts_sectors. The input is read
+ * in windows of whole sectors, which are split among the threads.
+ * \throw CryptoPP::InvalidArgument if the last sector is shorter than a
+ * block
+ * \param input_stream the input data stream to be encrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data of the data key, for encryption
+ * \param tweak_data white box data of the tweak key, for encryption
+ * \param first_sector sector number of the start of the stream
+ * \param sector_size bytes per sector, at least AES_BLOCK_SIZE_BYTES
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void encrypt_xts_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                      uint64_t first_sector, size_t sector_size,
+                      ThreadPool *pool);
+
+/*!
+ * \brief Decrypt the given input stream in AES-XTS mode, see
+ * encrypt_xts_mode
+ * \param input_stream the input data stream to be decrypted
+ * \param output_stream the output data stream to be written to
+ * \param data white box data of the data key, for decryption
+ * \param tweak_data white box data of the tweak key, for encryption
+ * \param first_sector sector number of the start of the stream
+ * \param sector_size bytes per sector, at least AES_BLOCK_SIZE_BYTES
+ * \param pool threads to run on; nullptr runs on the calling thread
+ */
+void decrypt_xts_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                      uint64_t first_sector, size_t sector_size,
+                      ThreadPool *pool);
+}  // namespace WhiteBox
+
+#endif  // WHITEBOX_XTSMODE_H_
@@ -305,4 +305,16 @@ State operator^(const State &lhs, const State &rhs) {
                  [](auto a, auto b) { return a ^ b; });
   return return_val;
 }
+
+State add_to_counter(const State &counter, uint64_t value) {
+  State result = counter;
+  // Add from the least significant (last) byte upwards, carrying over
+  uint64_t carry = value;
+  for (size_t i = AES_BLOCK_SIZE_BYTES; i-- > 0 && carry != 0;) {
+    uint32_t sum = static_cast<uint32_t>(carry & 0xFFU) + result[i];
+    result[i] = static_cast<uint8_t>(sum);
+    carry = (carry >> 8U) + (sum >> 8U);
+  }
+  return result;
+}
 }  // namespace WhiteBox
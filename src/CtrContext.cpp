@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include <CtrContext.h>
+#include <WhiteBoxInterpreter.h>
+
+namespace WhiteBox {
+namespace {
+size_t ring_size(size_t lookahead_blocks) {
+  size_t size = 1;
+  while (size < lookahead_blocks) size *= 2;
+  return size;
+}
+}  // namespace
+
+CtrContext::CtrContext(const WhiteBoxData &data, const State &iv,
+                       size_t lookahead_blocks)
+    : data_(data),
+      iv_(iv),
+      ring_(ring_size(lookahead_blocks)),
+      mask_(ring_.size() - 1),
+      producer_(&CtrContext::producerLoop, this) {}
+
+CtrContext::~CtrContext() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  spaceAvailable_.notify_one();
+  producer_.join();
+}
+
+void CtrContext::process(const uint8_t *input, uint8_t *output,
+                         size_t length) {
+  uint64_t block = position_ / AES_BLOCK_SIZE_BYTES;
+  size_t offset = position_ % AES_BLOCK_SIZE_BYTES;
+
+  while (length > 0) {
+    const State &keystream = readyBlock(block);
+    size_t n = std::min(length, AES_BLOCK_SIZE_BYTES - offset);
+    for (size_t j = 0; j < n; ++j)
+      output[j] = input[j] ^ keystream[offset + j];
+
+    input += n;
+    output += n;
+    length -= n;
+    position_ += n;
+    if (offset + n == AES_BLOCK_SIZE_BYTES) ++block;
+    offset = 0;
+  }
+  // A partially used block stays reserved for the next call
+  releaseBlocks(block);
+}
+
+uint64_t CtrContext::position() const { return position_; }
+
+size_t CtrContext::lookaheadBlocks() const { return ring_.size(); }
+
+const State &CtrContext::readyBlock(uint64_t block) {
+  if (block >= ready_) {
+    ready_ = produced_.load(std::memory_order_acquire);
+    if (block >= ready_) {
+      // Hand back what is used up, or a full ring would never refill
+      releaseBlocks(block);
+      while (block >= (ready_ = produced_.load(std::memory_order_acquire)))
+        std::this_thread::yield();
+    }
+  }
+  return ring_[block & mask_];
+}
+
+void CtrContext::releaseBlocks(uint64_t block) {
+  if (block == consumed_.load(std::memory_order_relaxed)) return;
+  // Sequentially consistent with producerWaiting_, so either the producer
+  // sees the new value before it sleeps or it is woken up here
+  consumed_.store(block);
+  if (producerWaiting_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spaceAvailable_.notify_one();
+  }
+}
+
+void CtrContext::producerLoop() {
+  const uint64_t capacity = ring_.size();
+  uint64_t produced = 0;
+
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    uint64_t free =
+        capacity - (produced - consumed_.load(std::memory_order_acquire));
+    if (free == 0) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      producerWaiting_ = true;
+      spaceAvailable_.wait(lock, [&] {
+        return stopping_ || consumed_.load() + capacity != produced;
+      });
+      producerWaiting_ = false;
+      continue;
+    }
+
+    // Fill up to the end of the ring, one staging batch at a time
+    size_t slot = produced & mask_;
+    size_t blocks = std::min<uint64_t>(
+        {free, INTERPRETER_STAGING_BLOCKS, capacity - slot});
+    interpret_white_box_ctr(data_, iv_, produced, &ring_[slot], blocks);
+
+    produced += blocks;
+    produced_.store(produced, std::memory_order_release);
+  }
+}
+}  // namespace WhiteBox
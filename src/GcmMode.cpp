@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <cryptopp/filters.h>
+
+#include <GcmMode.h>
+#include <ParallelModes.h>
+#include <WhiteBoxInterpreter.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WHITEBOX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace WhiteBox {
+namespace {
+constexpr size_t BLOCKS_PER_CHUNK = PARALLEL_CHUNK_SIZE / AES_BLOCK_SIZE_BYTES;
+
+// NIST SP 800-38D limits the plaintext to 2^39 - 256 bits
+constexpr uint64_t GCM_MAX_MESSAGE_LENGTH = (uint64_t{1} << 36) - 32;
+
+// Reduction of the 4 bits shifted out of a scalar multiplication step
+constexpr std::array<uint64_t, 16> GHASH_REDUCTION = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0};
+
+uint64_t load_big_endian_64(const uint8_t *bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < 8; ++i) value = (value << 8U) | bytes[i];
+  return value;
+}
+
+void store_big_endian_64(uint64_t value, uint8_t *bytes) {
+  for (size_t i = 0; i < 8; ++i)
+    bytes[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+}
+
+// x * H with the 4-bit tables of the key, processing x from its last
+// nibble to its first
+State ghash_multiply(const GhashKey &key, const State &x) {
+  uint8_t nibble = x[15] & 0xFU;
+  uint64_t high = key.high_[nibble];
+  uint64_t low = key.low_[nibble];
+
+  for (int i = 15; i >= 0; --i) {
+    for (int half = (i == 15) ? 1 : 0; half < 2; ++half) {
+      nibble = (half == 0) ? (x[i] & 0xFU) : (x[i] >> 4U);
+      uint8_t carry = low & 0xFU;
+      low = (high << 60U) | (low >> 4U);
+      high = (high >> 4U) ^ (GHASH_REDUCTION[carry] << 48U);
+      high ^= key.high_[nibble];
+      low ^= key.low_[nibble];
+    }
+  }
+
+  State result;
+  store_big_endian_64(high, result.data());
+  store_big_endian_64(low, result.data() + 8);
+  return result;
+}
+
+// Product of two field elements; only used for the few multiplications
+// outside of the hashed data
+State ghash_multiply(const State &x, const State &y) {
+  return ghash_multiply(GhashKey(y), x);
+}
+
+State ghash_power(const State &h, uint64_t exponent) {
+  State result{};
+  result[0] = 0x80;  // 1 in GCM's bit order
+  State base = h;
+  for (; exponent > 0; exponent >>= 1U) {
+    if (exponent & 1U) result = ghash_multiply(result, base);
+    base = ghash_multiply(base, base);
+  }
+  return result;
+}
+
+// Hashes length bytes; a partial last block is padded with zeros
+void ghash_bytes(const GhashKey &key, State &y, const uint8_t *bytes,
+                 size_t length) {
+  size_t blocks = length / AES_BLOCK_SIZE_BYTES;
+  ghash_blocks(key, y, bytes, blocks);
+  size_t remainder = length % AES_BLOCK_SIZE_BYTES;
+  if (remainder != 0) {
+    State last{};
+    std::memcpy(last.data(), bytes + blocks * AES_BLOCK_SIZE_BYTES,
+                remainder);
+    ghash_blocks(key, y, last.data(), 1);
+  }
+}
+
+// Hashes the bit lengths of two inputs, as at the end of GHASH
+void ghash_lengths(const GhashKey &key, State &y, uint64_t first_length,
+                   uint64_t second_length) {
+  State lengths;
+  store_big_endian_64(first_length * 8, lengths.data());
+  store_big_endian_64(second_length * 8, lengths.data() + 8);
+  ghash_blocks(key, y, lengths.data(), 1);
+}
+
+// GCM increments only the last 32 bits of the counter, so the keystream
+// is applied in two CTR runs if they wrap
+void apply_gcm_keystream(const WhiteBoxData &data, const State &j0,
+                         uint64_t first_block, uint8_t *buffer,
+                         size_t length) {
+  uint32_t start = ((uint32_t{j0[12]} << 24U) | (uint32_t{j0[13]} << 16U) |
+                    (uint32_t{j0[14]} << 8U) | j0[15]) +
+                   1 + static_cast<uint32_t>(first_block);
+  State counter = j0;
+  for (size_t i = 0; i < 4; ++i)
+    counter[12 + i] = static_cast<uint8_t>(start >> (24 - 8 * i));
+
+  uint64_t blocks_to_wrap = (uint64_t{1} << 32U) - start;
+  size_t head = static_cast<size_t>(
+      std::min<uint64_t>(length, blocks_to_wrap * AES_BLOCK_SIZE_BYTES));
+  apply_ctr_keystream(data, counter, 0, buffer, head);
+  if (head < length) {
+    std::fill(counter.begin() + 12, counter.end(), 0);
+    apply_ctr_keystream(data, counter, 0, buffer + head, length - head);
+  }
+}
+
+// Running GCM computation over a message that is passed in pieces
+class GcmContext {
+ public:
+  GcmContext(const WhiteBoxData &data, const uint8_t *iv, size_t iv_length,
+             const uint8_t *aad, size_t aad_length)
+      : data_(data),
+        key_(interpret_white_box(data, State{}, false)),
+        chunkPower_(ghash_power(key_.h_, BLOCKS_PER_CHUNK)),
+        aadLength_(aad_length) {
+    if (iv_length == 0)
+      throw CryptoPP::InvalidArgument("GCM: IV must not be empty");
+    if (iv_length == 12) {
+      std::copy_n(iv, iv_length, j0_.begin());
+      j0_[15] = 1;
+    } else {
+      ghash_bytes(key_, j0_, iv, iv_length);
+      ghash_lengths(key_, j0_, 0, iv_length);
+    }
+    ghash_bytes(key_, y_, aad, aad_length);
+  }
+
+  // Encrypts or decrypts the next piece of the message in place, in
+  // chunks on the pool. Each chunk is hashed from zero by its task and the
+  // results are combined in order: y * H^n ^ hash of the chunk, for a
+  // chunk of n blocks. All pieces but the last must be whole blocks.
+  void process(uint8_t *buffer, size_t length, bool encrypt,
+               ThreadPool *pool) {
+    if (length > GCM_MAX_MESSAGE_LENGTH - messageLength_)
+      throw CryptoPP::InvalidArgument("GCM: message length exceeds maximum");
+
+    const uint64_t first_block = messageLength_ / AES_BLOCK_SIZE_BYTES;
+    size_t num_chunks = (length + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    std::vector<State> chunk_hashes(num_chunks);
+
+    auto task = [&](size_t chunk) {
+      size_t begin = chunk * PARALLEL_CHUNK_SIZE;
+      size_t chunk_length = std::min(PARALLEL_CHUNK_SIZE, length - begin);
+      uint64_t block = first_block + begin / AES_BLOCK_SIZE_BYTES;
+      State &hash = chunk_hashes[chunk];
+      hash.fill(0);
+      // GHASH always runs over the ciphertext
+      if (encrypt)
+        apply_gcm_keystream(data_, j0_, block, buffer + begin, chunk_length);
+      ghash_bytes(key_, hash, buffer + begin, chunk_length);
+      if (!encrypt)
+        apply_gcm_keystream(data_, j0_, block, buffer + begin, chunk_length);
+    };
+    if (pool != nullptr) {
+      pool->parallelFor(num_chunks, task);
+    } else {
+      for (size_t chunk = 0; chunk < num_chunks; ++chunk) task(chunk);
+    }
+
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+      size_t chunk_length =
+          std::min(PARALLEL_CHUNK_SIZE, length - chunk * PARALLEL_CHUNK_SIZE);
+      size_t blocks =
+          (chunk_length + AES_BLOCK_SIZE_BYTES - 1) / AES_BLOCK_SIZE_BYTES;
+      y_ = ghash_multiply(y_, (blocks == BLOCKS_PER_CHUNK)
+                                  ? chunkPower_
+                                  : ghash_power(key_.h_, blocks)) ^
+           chunk_hashes[chunk];
+    }
+    messageLength_ += length;
+  }
+
+  std::array<uint8_t, GCM_TAG_SIZE> tag() const {
+    State y = y_;
+    ghash_lengths(key_, y, aadLength_, messageLength_);
+    State tag = interpret_white_box(data_, j0_, false) ^ y;
+    std::array<uint8_t, GCM_TAG_SIZE> result;
+    std::copy(tag.begin(), tag.end(), result.begin());
+    return result;
+  }
+
+  // Compares without an early exit, so the time taken does not tell how
+  // many bytes matched
+  bool verify(const uint8_t *expected_tag) const {
+    std::array<uint8_t, GCM_TAG_SIZE> actual_tag = tag();
+    uint8_t difference = 0;
+    for (size_t i = 0; i < GCM_TAG_SIZE; ++i)
+      difference |= actual_tag[i] ^ expected_tag[i];
+    return difference == 0;
+  }
+
+ private:
+  const WhiteBoxData &data_;
+  const GhashKey key_;
+  // H^BLOCKS_PER_CHUNK, for combining the hashes of full chunks
+  const State chunkPower_;
+  State j0_{};
+  State y_{};
+  const uint64_t aadLength_;
+  uint64_t messageLength_ = 0;
+};
+
+size_t window_size(ThreadPool *pool) {
+  return PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD *
+         ((pool != nullptr) ? pool->numThreads() : 1);
+}
+}  // namespace
+
+GhashKey::GhashKey(const State &h) : h_(h) {
+  // Entry 8 is H; halving the index shifts H right by one bit in GCM's
+  // reflected order, reducing by the field polynomial
+  uint64_t high = load_big_endian_64(h.data());
+  uint64_t low = load_big_endian_64(h.data() + 8);
+  high_[0] = 0;
+  low_[0] = 0;
+  high_[8] = high;
+  low_[8] = low;
+  for (size_t i = 4; i > 0; i >>= 1U) {
+    uint64_t reduction = (low & 1U) ? 0xe100000000000000ULL : 0;
+    low = (high << 63U) | (low >> 1U);
+    high = (high >> 1U) ^ reduction;
+    high_[i] = high;
+    low_[i] = low;
+  }
+  // The other entries are sums of those
+  for (size_t i = 2; i <= 8; i *= 2) {
+    for (size_t j = 1; j < i; ++j) {
+      high_[i + j] = high_[i] ^ high_[j];
+      low_[i + j] = low_[i] ^ low_[j];
+    }
+  }
+}
+
+void ghash_blocks_scalar(const GhashKey &key, State &y, const uint8_t *blocks,
+                         size_t n) {
+  for (size_t b = 0; b < n; ++b) {
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      y[i] ^= blocks[b * AES_BLOCK_SIZE_BYTES + i];
+    y = ghash_multiply(key, y);
+  }
+}
+
+#ifdef WHITEBOX_X86_SIMD
+#define WHITEBOX_PCLMUL __attribute__((target("pclmul,ssse3")))
+
+namespace {
+// Field elements are byte-reversed into registers, so that bit i of GCM's
+// order is bit 127 - i of the register
+WHITEBOX_PCLMUL inline __m128i load_reflected(const uint8_t *bytes) {
+  const __m128i reverse =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  return _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes)), reverse);
+}
+
+WHITEBOX_PCLMUL inline void store_reflected(__m128i value, uint8_t *bytes) {
+  const __m128i reverse =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes),
+                   _mm_shuffle_epi8(value, reverse));
+}
+
+// a * b in GF(2^128): a 256-bit carry-less product, shifted left by one
+// bit for the reflected order and reduced modulo x^128 + x^7 + x^2 + x + 1
+// (Gueron and Kounavis, Intel carry-less multiplication white paper)
+WHITEBOX_PCLMUL inline __m128i ghash_multiply_pclmul(__m128i a, __m128i b) {
+  __m128i low = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                 _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i high = _mm_clmulepi64_si128(a, b, 0x11);
+  low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+  high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+  // Shift the product left by one bit
+  __m128i low_carry = _mm_srli_epi32(low, 31);
+  __m128i high_carry = _mm_srli_epi32(high, 31);
+  low = _mm_slli_epi32(low, 1);
+  high = _mm_slli_epi32(high, 1);
+  __m128i cross_carry = _mm_srli_si128(low_carry, 12);
+  high_carry = _mm_slli_si128(high_carry, 4);
+  low_carry = _mm_slli_si128(low_carry, 4);
+  low = _mm_or_si128(low, low_carry);
+  high = _mm_or_si128(_mm_or_si128(high, high_carry), cross_carry);
+
+  // Reduce the lower half into the upper one
+  __m128i left = _mm_xor_si128(
+      _mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)),
+      _mm_slli_epi32(low, 25));
+  __m128i left_carry = _mm_srli_si128(left, 4);
+  low = _mm_xor_si128(low, _mm_slli_si128(left, 12));
+  __m128i right = _mm_xor_si128(
+      _mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)),
+      _mm_xor_si128(_mm_srli_epi32(low, 7), left_carry));
+  return _mm_xor_si128(high, _mm_xor_si128(low, right));
+}
+}  // namespace
+
+bool cpu_supports_pclmul() {
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+WHITEBOX_PCLMUL void ghash_blocks_pclmul(const GhashKey &key, State &y,
+                                         const uint8_t *blocks, size_t n) {
+  const __m128i h = load_reflected(key.h_.data());
+  __m128i state = load_reflected(y.data());
+  for (size_t b = 0; b < n; ++b) {
+    __m128i block = load_reflected(blocks + b * AES_BLOCK_SIZE_BYTES);
+    state = ghash_multiply_pclmul(_mm_xor_si128(state, block), h);
+  }
+  store_reflected(state, y.data());
+}
+#else
+bool cpu_supports_pclmul() { return false; }
+
+void ghash_blocks_pclmul(const GhashKey &key, State &y, const uint8_t *blocks,
+                         size_t n) {
+  ghash_blocks_scalar(key, y, blocks, n);
+}
+#endif
+
+void ghash_blocks(const GhashKey &key, State &y, const uint8_t *blocks,
+                  size_t n) {
+  static const bool use_pclmul = cpu_supports_pclmul();
+  if (use_pclmul)
+    ghash_blocks_pclmul(key, y, blocks, n);
+  else
+    ghash_blocks_scalar(key, y, blocks, n);
+}
+
+void encrypt_gcm(const WhiteBoxData &data, const uint8_t *iv,
+                 size_t iv_length, const uint8_t *aad, size_t aad_length,
+                 const uint8_t *input, uint8_t *output, size_t length,
+                 uint8_t *tag) {
+  GcmContext context(data, iv, iv_length, aad, aad_length);
+  if (output != input) std::memmove(output, input, length);
+  context.process(output, length, true, nullptr);
+  std::array<uint8_t, GCM_TAG_SIZE> result = context.tag();
+  std::copy(result.begin(), result.end(), tag);
+}
+
+bool decrypt_gcm(const WhiteBoxData &data, const uint8_t *iv,
+                 size_t iv_length, const uint8_t *aad, size_t aad_length,
+                 const uint8_t *input, uint8_t *output, size_t length,
+                 const uint8_t *tag) {
+  GcmContext context(data, iv, iv_length, aad, aad_length);
+  if (output != input) std::memmove(output, input, length);
+  context.process(output, length, false, nullptr);
+  if (context.verify(tag)) return true;
+  // Unauthenticated plaintext must not be left behind
+  std::fill_n(output, length, 0);
+  return false;
+}
+
+void encrypt_gcm_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const uint8_t *iv,
+                      size_t iv_length, const uint8_t *aad, size_t aad_length,
+                      ThreadPool *pool) {
+  GcmContext context(data, iv, iv_length, aad, aad_length);
+  std::vector<uint8_t> buffer(window_size(pool));
+
+  while (input_stream) {
+    input_stream.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    auto length = static_cast<size_t>(input_stream.gcount());
+    if (length == 0) break;
+    // Only the last read can end in a partial block
+    context.process(buffer.data(), length, true, pool);
+    output_stream.write(reinterpret_cast<const char *>(buffer.data()), length);
+  }
+
+  std::array<uint8_t, GCM_TAG_SIZE> tag = context.tag();
+  output_stream.write(reinterpret_cast<const char *>(tag.data()), tag.size());
+}
+
+void decrypt_gcm_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const uint8_t *iv,
+                      size_t iv_length, const uint8_t *aad, size_t aad_length,
+                      ThreadPool *pool) {
+  GcmContext context(data, iv, iv_length, aad, aad_length);
+  const size_t window = window_size(pool);
+  // The last GCM_TAG_SIZE bytes read so far may be the tag, so they are
+  // held back until more input follows
+  std::vector<uint8_t> buffer(window + GCM_TAG_SIZE);
+  size_t held = 0;
+
+  for (;;) {
+    input_stream.read(reinterpret_cast<char *>(buffer.data() + held),
+                      buffer.size() - held);
+    size_t available = held + static_cast<size_t>(input_stream.gcount());
+    bool last = available < buffer.size() ||
+                input_stream.peek() == std::char_traits<char>::eof();
+
+    if (last) {
+      if (available < GCM_TAG_SIZE)
+        throw CryptoPP::InvalidCiphertext(
+            "GCM: ciphertext is shorter than the authentication tag");
+      size_t length = available - GCM_TAG_SIZE;
+      context.process(buffer.data(), length, false, pool);
+      // The last window is only released once the tag has been checked
+      if (!context.verify(buffer.data() + length))
+        throw CryptoPP::HashVerificationFilter::HashVerificationFailed();
+      output_stream.write(reinterpret_cast<const char *>(buffer.data()),
+                          length);
+      return;
+    }
+
+    context.process(buffer.data(), window, false, pool);
+    output_stream.write(reinterpret_cast<const char *>(buffer.data()), window);
+    std::memmove(buffer.data(), buffer.data() + window, GCM_TAG_SIZE);
+    held = GCM_TAG_SIZE;
+  }
+}
+}  // namespace WhiteBox
@@ -4,11 +4,13 @@
 //
 
 #include <memory>
+#include <cstdio>
 #include <algorithm>
 #include <array>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 
 #include <boost/archive/text_iarchive.hpp>
@@ -17,24 +19,51 @@
 #include <boost/program_options.hpp>
 #include <boost/serialization/array.hpp>
 
+#include <GcmMode.h>
+#include <ParallelModes.h>
 #include <Test.h>
+#include <ThreadPool.h>
 #include <WhiteBoxInterpreter.h>
+#include <WhiteBoxStorage.h>
 #include <WhiteBoxTableGenerator.h>
+#include <XtsMode.h>
 #include <ExternalEncoding.h>
 
-void create_encryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
-  WhiteBox::ExternalEncoding* input_encoding, WhiteBox::ExternalEncoding* output_encoding);
+/*! \brief Generate the encryption tables and write them in the chosen format
+ *  \return false if the tables could not be written
+ */
+bool create_encryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
+  bool binary, WhiteBox::ExternalEncoding* input_encoding,
+  WhiteBox::ExternalEncoding* output_encoding, WhiteBox::ThreadPool* pool,
+  WhiteBox::TableGranularity granularity);
 
-void create_decryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
-  WhiteBox::ExternalEncoding* input_encoding, WhiteBox::ExternalEncoding* output_encoding);
+/*! \brief Generate the decryption tables and write them in the chosen format
+ *  \return false if the tables could not be written
+ */
+bool create_decryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
+  bool binary, WhiteBox::ExternalEncoding* input_encoding,
+  WhiteBox::ExternalEncoding* output_encoding, WhiteBox::ThreadPool* pool,
+  WhiteBox::TableGranularity granularity);
+
+/*! \brief Load a white box table in the text or binary format
+ *  \param path table file
+ *  \param huge_pages whether to place the table on huge pages
+ *  \return the table, or nullptr after printing an error
+ */
+WhiteBox::WhiteBoxDataPtr load_table(const std::string &path,
+                                     bool huge_pages);
 
 void encrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
              std::istream &istream, std::ostream &ostream,
-             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding);
+             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding,
+             WhiteBox::ThreadPool *pool,
+             const WhiteBox::WhiteBoxData *tweak_data, size_t sector_size);
 
 void decrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
              std::istream &istream, std::ostream &ostream,
-             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding);
+             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding,
+             WhiteBox::ThreadPool *pool,
+             const WhiteBox::WhiteBoxData *tweak_data, size_t sector_size);
 
 /*! \brief Entry point to the application
  *  \param argc command line parameters
@@ -45,7 +74,9 @@ int main(int argc, const char *argv[]) {
   std::map<std::string, WhiteBox::BlockCipherMode> mode_map =
       boost::assign::map_list_of("ECB", WhiteBox::BlockCipherMode::ECB)(
           "CBC", WhiteBox::BlockCipherMode::CBC)(
-          "CTR", WhiteBox::BlockCipherMode::CTR);
+          "CTR", WhiteBox::BlockCipherMode::CTR)(
+          "GCM", WhiteBox::BlockCipherMode::GCM)(
+          "XTS", WhiteBox::BlockCipherMode::XTS);
 
   std::map<std::string, WhiteBox::PaddingMode> padding_map =
       boost::assign::map_list_of("NONE", WhiteBox::PaddingMode::NONE)(
@@ -53,6 +84,10 @@ int main(int argc, const char *argv[]) {
                                                  WhiteBox::PaddingMode::PKCS)(
           "ONE_AND_ZEROS", WhiteBox::PaddingMode::ONE_AND_ZEROS);
 
+  std::map<std::string, WhiteBox::TableGranularity> granularity_map =
+      boost::assign::map_list_of("nibble", WhiteBox::TableGranularity::NIBBLE)(
+          "byte", WhiteBox::TableGranularity::BYTE);
+
   boost::program_options::options_description command_line_options;
 
   // Command line parsing
@@ -64,15 +99,19 @@ int main(int argc, const char *argv[]) {
       "create-decryption-tables", boost::program_options::value<std::string>(),
       "Create decryption table in given file")
       ("create-c-file", "Create valid C code for use in another program")
+      ("binary-tables", "Create tables in the binary format, which can be "
+      "memory-mapped instead of parsed when loading")
       (
       "key", boost::program_options::value<std::string>(),
       "AES Key used for encryption/decryption, hexadecimal format")(
       "whitebox-table", boost::program_options::value<std::string>(),
-      "Load given white box table")(
+      "Load given white box table, text or binary format")(
       "set-mode", boost::program_options::value<std::string>(),
-      "Set block cipher mode, either ECB, CBC or CTR, default CBC")(
+      "Set block cipher mode, either ECB, CBC, CTR, GCM or XTS, default CBC; "
+      "GCM appends the authentication tag when encrypting and verifies it "
+      "when decrypting")(
       "iv", boost::program_options::value<std::string>(),
-      "Set initialization vector")(
+      "Set initialization vector, 16 bytes in hexadecimal format")(
       "set-padding", boost::program_options::value<std::string>(),
       "Set padding mode, either NONE, ZEROS, PKCS or ONE_AND_ZEROS, default "
       "PKCS")(
@@ -92,7 +131,40 @@ int main(int argc, const char *argv[]) {
     ("apply-input-encoding", boost::program_options::value<std::string>(),
       "Apply input encoding to whitebox")
     ("apply-output-encoding", boost::program_options::value<std::string>(),
-      "Apply output encoding to whitebox");
+      "Apply output encoding to whitebox")
+    ("threads", boost::program_options::value<size_t>(),
+      "Number of threads used for table creation, CTR, GCM, XTS, ECB and CBC "
+      "decryption, 0 for one per hardware thread, default 1")
+    ("packed-xor-tables",
+      "Use nibble-packed XOR tables for the loaded white box, halving their "
+      "cache footprint")
+    ("backend", boost::program_options::value<std::string>(),
+      "Interpreter backend, either auto, scalar, sse4, avx2 or avx512, "
+      "default auto, which picks the fastest one the CPU supports")
+    ("prefault",
+      "Touch all pages of the loaded white box and run dummy blocks on every "
+      "thread before processing data, for stable latency from the first block")
+    ("lock-tables",
+      "Lock the pages of the loaded white box into memory, implies "
+      "--prefault")
+    ("table-granularity", boost::program_options::value<std::string>(),
+      "Width of the XOR tables of created tables, either nibble or byte, "
+      "default nibble; byte tables need half the lookups but 27 MiB per set "
+      "of XOR tables, which are derived when the tables are loaded")
+    ("huge-pages",
+      "Place the loaded white box on 2 MiB huge pages to reduce TLB misses, "
+      "falling back to transparent huge pages if none are reserved")
+    ("tweak-table", boost::program_options::value<std::string>(),
+      "Encryption white box of the tweak key for XTS mode; --whitebox-table "
+      "holds the data key")
+    ("sector-size", boost::program_options::value<size_t>(),
+      "Bytes per XTS sector, sectors are numbered from 0, default 512")
+    ("offset", boost::program_options::value<uint64_t>(),
+      "CTR decryption only: decrypt the range of the input starting at this "
+      "byte offset, default 0")
+    ("length", boost::program_options::value<uint64_t>(),
+      "CTR decryption only: length of the range to decrypt in bytes, "
+      "default up to the end of the input");
 
   boost::program_options::variables_map variables;
   try {
@@ -130,6 +202,7 @@ int main(int argc, const char *argv[]) {
   bool has_input_file = false;
   bool has_output_file = false;
   bool create_code = false;
+  bool create_binary = false;
   bool has_input_encoding = false;
   bool has_output_encoding = false;
 
@@ -137,7 +210,10 @@ int main(int argc, const char *argv[]) {
   WhiteBox::State key;
   WhiteBox::State iv;
 
-  WhiteBox::WhiteBoxData whitebox_table{};
+  WhiteBox::WhiteBoxDataPtr whitebox_table;
+  WhiteBox::WhiteBoxDataPtr tweak_table;
+  size_t sector_size = WhiteBox::DEFAULT_XTS_SECTOR_SIZE;
+  std::unique_ptr<WhiteBox::ThreadPool> thread_pool;
 
   std::ofstream encryption_table_output;
   std::ofstream decryption_table_output;
@@ -156,6 +232,35 @@ int main(int argc, const char *argv[]) {
     create_code = true;
   }
 
+  // A single thread keeps using the Crypto++ mode implementations
+  if (variables.count("threads") && variables["threads"].as<size_t>() != 1) {
+    thread_pool =
+        std::make_unique<WhiteBox::ThreadPool>(variables["threads"].as<size_t>());
+  }
+
+  if (variables.count("backend")) {
+    WhiteBox::InterpreterBackend backend;
+    if (!WhiteBox::parse_interpreter_backend(
+            backend, variables["backend"].as<std::string>())) {
+      std::cerr << "Invalid interpreter backend" << std::endl;
+      return -1;
+    }
+    if (!WhiteBox::select_interpreter_backend(backend)) {
+      std::cerr << "Interpreter backend is not supported by this CPU or "
+                   "failed its self-check" << std::endl;
+      return -1;
+    }
+  }
+
+  if (variables.count("binary-tables")) {
+    if (create_code) {
+      std::cerr << "C code and binary tables cannot be created at the same time"
+                << std::endl;
+      return -1;
+    }
+    create_binary = true;
+  }
+
   if (variables.count("create-external-encoding")) {
     std::string path = variables["create-external-encoding"].as<std::string>();
     std::ofstream ofs(path);
@@ -214,25 +319,51 @@ int main(int argc, const char *argv[]) {
   }
 
   if (variables.count("whitebox-table")) {
-    std::string path = variables["whitebox-table"].as<std::string>();
-    std::ifstream ifs(path);
-    if (ifs.good()) {
-      boost::archive::text_iarchive text_iarchive(ifs);
-      text_iarchive >> whitebox_table;
-      if (has_input_encoding)
-        input_encoding.applyToWhiteBox(&whitebox_table, true);
-      if (has_output_encoding)
-        output_encoding.applyToWhiteBox(&whitebox_table, false);
-      has_table = true;
-    } else {
-      std::cerr << "Could not open white box table file" << std::endl;
+    whitebox_table =
+        load_table(variables["whitebox-table"].as<std::string>(),
+                   variables.count("huge-pages") != 0);
+    if (!whitebox_table)
+      return -1;
+    if (has_input_encoding)
+      input_encoding.applyToWhiteBox(whitebox_table.get(), true);
+    if (has_output_encoding)
+      output_encoding.applyToWhiteBox(whitebox_table.get(), false);
+    if (variables.count("packed-xor-tables"))
+      whitebox_table->packXorTables();
+    if (variables.count("prefault") || variables.count("lock-tables")) {
+      WhiteBox::WarmOptions warm_options;
+      warm_options.lock_ = variables.count("lock-tables") != 0;
+      warm_options.dummyBlocks_ = WhiteBox::INTERPRETER_STAGING_BLOCKS;
+      warm_options.pool_ = thread_pool.get();
+      if (!WhiteBox::warm(*whitebox_table, warm_options))
+        return -1;
+    }
+    has_table = true;
+  }
+
+  // The tweak key only encrypts sector numbers, so its table is neither
+  // encoded nor warmed
+  if (variables.count("tweak-table")) {
+    tweak_table = load_table(variables["tweak-table"].as<std::string>(),
+                             variables.count("huge-pages") != 0);
+    if (!tweak_table)
+      return -1;
+    if (variables.count("packed-xor-tables"))
+      tweak_table->packXorTables();
+  }
+
+  if (variables.count("sector-size")) {
+    sector_size = variables["sector-size"].as<size_t>();
+    if (sector_size < WhiteBox::AES_BLOCK_SIZE_BYTES) {
+      std::cerr << "Sector size must be at least one block" << std::endl;
       return -1;
     }
   }
 
   if (variables.count("create-encryption-tables")) {
     std::string path = variables["create-encryption-tables"].as<std::string>();
-    encryption_table_output.open(path);
+    encryption_table_output.open(
+        path, create_binary ? std::ios::out | std::ios::binary : std::ios::out);
     if (!encryption_table_output.good()) {
       std::cerr << "Could not open encryption table output file" << std::endl;
       return -1;
@@ -243,7 +374,8 @@ int main(int argc, const char *argv[]) {
 
   if (variables.count("create-decryption-tables")) {
     std::string path = variables["create-decryption-tables"].as<std::string>();
-    decryption_table_output.open(path);
+    decryption_table_output.open(
+        path, create_binary ? std::ios::out | std::ios::binary : std::ios::out);
     if (!decryption_table_output.good()) {
       std::cerr << "Could not open decryption table output file" << std::endl;
       return -1;
@@ -287,12 +419,26 @@ int main(int argc, const char *argv[]) {
     block_cipher_mode = WhiteBox::BlockCipherMode::CBC;
   }
 
+  WhiteBox::TableGranularity granularity = WhiteBox::TableGranularity::NIBBLE;
+  if (variables.count("table-granularity")) {
+    std::string name = variables["table-granularity"].as<std::string>();
+    if (granularity_map.count(name)) {
+      granularity = granularity_map[name];
+    } else {
+      std::cerr << "Could not parse table granularity" << std::endl;
+      return -1;
+    }
+  }
+
   if (variables.count("set-padding")) {
     std::string padding = variables["set-padding"].as<std::string>();
     if (padding_map.count(padding)) {
       padding_mode = padding_map[padding];
-      if (block_cipher_mode == WhiteBox::BlockCipherMode::CTR && padding_mode != WhiteBox::PaddingMode::NONE) {
-        std::cerr << "CTR does not use padding" << std::endl;
+      if ((block_cipher_mode == WhiteBox::BlockCipherMode::CTR ||
+           block_cipher_mode == WhiteBox::BlockCipherMode::GCM ||
+           block_cipher_mode == WhiteBox::BlockCipherMode::XTS) &&
+          padding_mode != WhiteBox::PaddingMode::NONE) {
+        std::cerr << "CTR, GCM and XTS do not use padding" << std::endl;
         return -1;
       }
     } else {
@@ -300,7 +446,9 @@ int main(int argc, const char *argv[]) {
       return -1;
     }
   } else {
-    if (block_cipher_mode != WhiteBox::BlockCipherMode::CTR)
+    if (block_cipher_mode != WhiteBox::BlockCipherMode::CTR &&
+        block_cipher_mode != WhiteBox::BlockCipherMode::GCM &&
+        block_cipher_mode != WhiteBox::BlockCipherMode::XTS)
       padding_mode = WhiteBox::PaddingMode::PKCS;
     else
       padding_mode = WhiteBox::PaddingMode::NONE;
@@ -324,7 +472,12 @@ int main(int argc, const char *argv[]) {
     if (has_output_encoding)
       output = &output_encoding;
 
-    create_encryption_tables(encryption_table_output, key, create_code, input, output);
+    if (!create_encryption_tables(encryption_table_output, key, create_code,
+                                  create_binary, input, output,
+                                  thread_pool.get(), granularity)) {
+      std::cerr << "Could not write encryption tables" << std::endl;
+      return -1;
+    }
   }
 
   if (variables.count("create-decryption-tables")) {
@@ -344,12 +497,26 @@ int main(int argc, const char *argv[]) {
     if (has_output_encoding)
       output = &output_encoding;
 
-    create_decryption_tables(decryption_table_output, key, create_code, input, output);
+    if (!create_decryption_tables(decryption_table_output, key, create_code,
+                                  create_binary, input, output,
+                                  thread_pool.get(), granularity)) {
+      std::cerr << "Could not write decryption tables" << std::endl;
+      return -1;
+    }
   }
 
   if (variables.count("encrypt")) {
-    if (block_cipher_mode != WhiteBox::BlockCipherMode::ECB && !has_iv) {
-      std::cerr << "IV needed for CBC/CTR modes" << std::endl;
+    if (variables.count("offset") || variables.count("length")) {
+      std::cerr << "Byte ranges can only be decrypted" << std::endl;
+      return -1;
+    }
+    if (block_cipher_mode != WhiteBox::BlockCipherMode::ECB &&
+        block_cipher_mode != WhiteBox::BlockCipherMode::XTS && !has_iv) {
+      std::cerr << "IV needed for CBC/CTR/GCM modes" << std::endl;
+      return -1;
+    }
+    if (block_cipher_mode == WhiteBox::BlockCipherMode::XTS && !tweak_table) {
+      std::cerr << "Tweak table needed for XTS mode" << std::endl;
       return -1;
     }
     if (!has_table) {
@@ -358,23 +525,38 @@ int main(int argc, const char *argv[]) {
       return -1;
     }
 
-    if (!has_input_file && !has_output_file)
-      encrypt(whitebox_table, iv, std::cin, std::cout, block_cipher_mode,
-              padding_mode);
-    else if (!has_input_file)
-      encrypt(whitebox_table, iv, std::cin, output_file, block_cipher_mode,
-              padding_mode);
-    else if (!has_output_file)
-      encrypt(whitebox_table, iv, input_file, std::cout, block_cipher_mode,
-              padding_mode);
-    else
-      encrypt(whitebox_table, iv, input_file, output_file, block_cipher_mode,
-              padding_mode);
+    try {
+      if (!has_input_file && !has_output_file)
+        encrypt(*whitebox_table, iv, std::cin, std::cout, block_cipher_mode,
+                padding_mode, thread_pool.get(), tweak_table.get(),
+                sector_size);
+      else if (!has_input_file)
+        encrypt(*whitebox_table, iv, std::cin, output_file, block_cipher_mode,
+                padding_mode, thread_pool.get(), tweak_table.get(),
+                sector_size);
+      else if (!has_output_file)
+        encrypt(*whitebox_table, iv, input_file, std::cout, block_cipher_mode,
+                padding_mode, thread_pool.get(), tweak_table.get(),
+                sector_size);
+      else
+        encrypt(*whitebox_table, iv, input_file, output_file,
+                block_cipher_mode, padding_mode, thread_pool.get(),
+                tweak_table.get(), sector_size);
+    } catch (CryptoPP::Exception &e) {
+      // E.g. an XTS input whose last sector is shorter than a block
+      std::cerr << e.what() << std::endl;
+      return -1;
+    }
   }
 
   if (variables.count("decrypt")) {
-    if (block_cipher_mode != WhiteBox::BlockCipherMode::ECB && !has_iv) {
-      std::cerr << "IV needed for CBC/CTR modes" << std::endl;
+    if (block_cipher_mode != WhiteBox::BlockCipherMode::ECB &&
+        block_cipher_mode != WhiteBox::BlockCipherMode::XTS && !has_iv) {
+      std::cerr << "IV needed for CBC/CTR/GCM modes" << std::endl;
+      return -1;
+    }
+    if (block_cipher_mode == WhiteBox::BlockCipherMode::XTS && !tweak_table) {
+      std::cerr << "Tweak table needed for XTS mode" << std::endl;
       return -1;
     }
     if (!has_table) {
@@ -382,18 +564,73 @@ int main(int argc, const char *argv[]) {
                 << std::endl;
       return -1;
     }
-    if (!has_input_file && !has_output_file)
-      decrypt(whitebox_table, iv, std::cin, std::cout, block_cipher_mode,
-              padding_mode);
-    else if (!has_input_file)
-      decrypt(whitebox_table, iv, std::cin, output_file, block_cipher_mode,
-              padding_mode);
-    else if (!has_output_file)
-      decrypt(whitebox_table, iv, input_file, std::cout, block_cipher_mode,
-              padding_mode);
-    else
-      decrypt(whitebox_table, iv, input_file, output_file, block_cipher_mode,
-              padding_mode);
+    if (variables.count("offset") || variables.count("length")) {
+      if (block_cipher_mode != WhiteBox::BlockCipherMode::CTR) {
+        std::cerr << "Byte ranges can only be decrypted in CTR mode"
+                  << std::endl;
+        return -1;
+      }
+      uint64_t offset =
+          variables.count("offset") ? variables["offset"].as<uint64_t>() : 0;
+      uint64_t length = variables.count("length")
+                            ? variables["length"].as<uint64_t>()
+                            : std::numeric_limits<uint64_t>::max();
+      std::istream &istream =
+          has_input_file ? static_cast<std::istream &>(input_file) : std::cin;
+      std::ostream &ostream =
+          has_output_file ? static_cast<std::ostream &>(output_file)
+                          : std::cout;
+      try {
+        uint64_t written = WhiteBox::decrypt_ctr_range(
+            *whitebox_table, iv, offset, length, istream, ostream,
+            thread_pool.get());
+        // A range cut off by the end of the input is an error
+        if (variables.count("length") && written < length) {
+          std::cerr << "Input ends after " << written << " of " << length
+                    << " bytes of the range" << std::endl;
+          return -1;
+        }
+        if (written == 0 && !variables.count("length")) {
+          std::cerr << "Offset is at or past the end of the input"
+                    << std::endl;
+          return -1;
+        }
+      } catch (CryptoPP::Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+      }
+    } else {
+      try {
+        if (!has_input_file && !has_output_file)
+          decrypt(*whitebox_table, iv, std::cin, std::cout, block_cipher_mode,
+                  padding_mode, thread_pool.get(), tweak_table.get(),
+                  sector_size);
+        else if (!has_input_file)
+          decrypt(*whitebox_table, iv, std::cin, output_file,
+                  block_cipher_mode, padding_mode, thread_pool.get(),
+                  tweak_table.get(), sector_size);
+        else if (!has_output_file)
+          decrypt(*whitebox_table, iv, input_file, std::cout,
+                  block_cipher_mode, padding_mode, thread_pool.get(),
+                  tweak_table.get(), sector_size);
+        else
+          decrypt(*whitebox_table, iv, input_file, output_file,
+                  block_cipher_mode, padding_mode, thread_pool.get(),
+                  tweak_table.get(), sector_size);
+      } catch (CryptoPP::HashVerificationFilter::HashVerificationFailed &e) {
+        // GCM tag mismatch: plaintext of earlier windows may already be in
+        // the output file, which must not be left behind
+        std::cerr << e.what() << std::endl;
+        if (has_output_file) {
+          output_file.close();
+          std::remove(variables["output-file"].as<std::string>().c_str());
+        }
+        return -1;
+      } catch (CryptoPP::Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+      }
+    }
   }
 
   if (variables.count("encrypt-state")) {
@@ -410,7 +647,7 @@ int main(int argc, const char *argv[]) {
           return -1;
       }
 
-      WhiteBox::State result = WhiteBox::interpret_white_box(whitebox_table, input_state, false);
+      WhiteBox::State result = WhiteBox::interpret_white_box(*whitebox_table, input_state, false);
       for (auto byte : result) {
           std::cout << std::hex << static_cast<int>(byte);
       }
@@ -420,9 +657,30 @@ int main(int argc, const char *argv[]) {
   return 0;
 }
 
+WhiteBox::WhiteBoxDataPtr load_table(const std::string &path,
+                                     bool huge_pages) {
+  if (WhiteBox::is_binary_table_file(path))
+    return WhiteBox::map_binary_table(path, huge_pages);
+
+  std::ifstream ifs(path);
+  if (!ifs.good()) {
+    std::cerr << "Could not open white box table file" << std::endl;
+    return nullptr;
+  }
+  WhiteBox::WhiteBoxDataPtr table =
+      WhiteBox::allocate_white_box_data(huge_pages);
+  if (!table)
+    return nullptr;
+  boost::archive::text_iarchive text_iarchive(ifs);
+  text_iarchive >> *table;
+  return table;
+}
+
 void encrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
              std::istream &istream, std::ostream &ostream,
-             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding) {
+             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding,
+             WhiteBox::ThreadPool *pool,
+             const WhiteBox::WhiteBoxData *tweak_data, size_t sector_size) {
              CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding_scheme;
 
   switch(padding) {
@@ -444,14 +702,29 @@ void encrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
 
   switch(mode) {
     case WhiteBox::BlockCipherMode::ECB:
-      WhiteBox::encrypt_ecb_mode(istream, ostream, &data, padding_scheme);
+      if (pool != nullptr)
+        WhiteBox::encrypt_ecb_mode_parallel(istream, ostream, data,
+                                            padding_scheme, *pool);
+      else
+        WhiteBox::encrypt_ecb_mode(istream, ostream, &data, padding_scheme);
       break;
     case WhiteBox::BlockCipherMode::CTR:
-      WhiteBox::encrypt_ctr_mode(istream, ostream, &data, iv, padding_scheme);
+      if (pool != nullptr)
+        WhiteBox::encrypt_ctr_mode_parallel(istream, ostream, data, iv, *pool);
+      else
+        WhiteBox::encrypt_ctr_mode(istream, ostream, &data, iv, padding_scheme);
       break;
     case WhiteBox::BlockCipherMode::CBC:
       WhiteBox::encrypt_cbc_mode(istream, ostream, &data, iv, padding_scheme);
       break;
+    case WhiteBox::BlockCipherMode::GCM:
+      WhiteBox::encrypt_gcm_mode(istream, ostream, data, iv.data(), iv.size(),
+                                 nullptr, 0, pool);
+      break;
+    case WhiteBox::BlockCipherMode::XTS:
+      WhiteBox::encrypt_xts_mode(istream, ostream, data, *tweak_data, 0,
+                                 sector_size, pool);
+      break;
     default:
       ;
   }
@@ -459,7 +732,9 @@ void encrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
 
 void decrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
              std::istream &istream, std::ostream &ostream,
-             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding) {
+             WhiteBox::BlockCipherMode mode, WhiteBox::PaddingMode padding,
+             WhiteBox::ThreadPool *pool,
+             const WhiteBox::WhiteBoxData *tweak_data, size_t sector_size) {
              CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding_scheme;
 
   switch(padding) {
@@ -481,49 +756,92 @@ void decrypt(WhiteBox::WhiteBoxData &data, const WhiteBox::State &iv,
 
   switch(mode) {
     case WhiteBox::BlockCipherMode::ECB:
-      WhiteBox::decrypt_ecb_mode(istream, ostream, &data, padding_scheme);
+      if (pool != nullptr)
+        WhiteBox::decrypt_ecb_mode_parallel(istream, ostream, data,
+                                            padding_scheme, *pool);
+      else
+        WhiteBox::decrypt_ecb_mode(istream, ostream, &data, padding_scheme);
       break;
     case WhiteBox::BlockCipherMode::CTR:
-      WhiteBox::decrypt_ctr_mode(istream, ostream, &data, iv, padding_scheme);
+      if (pool != nullptr)
+        WhiteBox::decrypt_ctr_mode_parallel(istream, ostream, data, iv, *pool);
+      else
+        WhiteBox::decrypt_ctr_mode(istream, ostream, &data, iv, padding_scheme);
       break;
     case WhiteBox::BlockCipherMode::CBC:
-      WhiteBox::decrypt_cbc_mode(istream, ostream, &data, iv, padding_scheme);
+      if (pool != nullptr)
+        WhiteBox::decrypt_cbc_mode_parallel(istream, ostream, data, iv,
+                                            padding_scheme, *pool);
+      else
+        WhiteBox::decrypt_cbc_mode(istream, ostream, &data, iv, padding_scheme);
+      break;
+    case WhiteBox::BlockCipherMode::GCM:
+      WhiteBox::decrypt_gcm_mode(istream, ostream, data, iv.data(), iv.size(),
+                                 nullptr, 0, pool);
+      break;
+    case WhiteBox::BlockCipherMode::XTS:
+      WhiteBox::decrypt_xts_mode(istream, ostream, data, *tweak_data, 0,
+                                 sector_size, pool);
       break;
     default:
       ;
   }
 }
 
-void create_decryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
-                              WhiteBox::ExternalEncoding* input_encoding, WhiteBox::ExternalEncoding* output_encoding) {
-  auto gen = std::make_unique<WhiteBox::WhiteBoxTableGenerator>(key, true, true);
+bool create_decryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
+                              bool binary, WhiteBox::ExternalEncoding* input_encoding,
+                              WhiteBox::ExternalEncoding* output_encoding,
+                              WhiteBox::ThreadPool* pool,
+                              WhiteBox::TableGranularity granularity) {
+  auto gen = std::make_unique<WhiteBox::WhiteBoxTableGenerator>(
+      key, true, true, WhiteBox::TableDirection::DECRYPTION, pool,
+      granularity);
   std::unique_ptr<WhiteBox::WhiteBoxData> data(gen->getDecryptionTable());
   if (input_encoding != nullptr)
     input_encoding->applyToWhiteBox(data.get(), true);
   if (output_encoding != nullptr)
     output_encoding->applyToWhiteBox(data.get(), false);
 
+  if (binary)
+    return WhiteBox::write_binary_table(*data, ofstream);
   if (!code) {
-    boost::archive::text_oarchive ar(ofstream);
-    ar << *data;
+    try {
+      boost::archive::text_oarchive ar(ofstream);
+      ar << *data;
+    } catch (const boost::archive::archive_exception &) {
+      return false;
+    }
   } else {
     data->serializeToCStruct(ofstream);
   }
+  return static_cast<bool>(ofstream.flush());
 }
 
-void create_encryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
-                              WhiteBox::ExternalEncoding* input_encoding, WhiteBox::ExternalEncoding* output_encoding) {
-  auto gen = std::make_unique<WhiteBox::WhiteBoxTableGenerator>(key, true, true);
+bool create_encryption_tables(std::ofstream &ofstream, WhiteBox::State key, bool code,
+                              bool binary, WhiteBox::ExternalEncoding* input_encoding,
+                              WhiteBox::ExternalEncoding* output_encoding,
+                              WhiteBox::ThreadPool* pool,
+                              WhiteBox::TableGranularity granularity) {
+  auto gen = std::make_unique<WhiteBox::WhiteBoxTableGenerator>(
+      key, true, true, WhiteBox::TableDirection::ENCRYPTION, pool,
+      granularity);
   std::unique_ptr<WhiteBox::WhiteBoxData> data(gen->getEncryptionTable());
   if (input_encoding != nullptr)
     input_encoding->applyToWhiteBox(data.get(), true);
   if (output_encoding != nullptr)
     output_encoding->applyToWhiteBox(data.get(), false);
 
+  if (binary)
+    return WhiteBox::write_binary_table(*data, ofstream);
   if (!code) {
-    boost::archive::text_oarchive ar(ofstream);
-    ar << *data;
+    try {
+      boost::archive::text_oarchive ar(ofstream);
+      ar << *data;
+    } catch (const boost::archive::archive_exception &) {
+      return false;
+    }
   } else {
     data->serializeToCStruct(ofstream);
   }
+  return static_cast<bool>(ofstream.flush());
 }
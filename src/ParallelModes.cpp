@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <ParallelModes.h>
+#include <WhiteBoxInterpreter.h>
+
+namespace WhiteBox {
+static_assert(PARALLEL_CHUNK_SIZE % AES_BLOCK_SIZE_BYTES == 0,
+              "Chunks have to consist of whole blocks");
+
+namespace {
+constexpr size_t BLOCKS_PER_CHUNK = PARALLEL_CHUNK_SIZE / AES_BLOCK_SIZE_BYTES;
+
+typedef CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme PaddingScheme;
+
+// Processes a span of whole blocks of a window:
+// (window input, window output, first block of the span, number of blocks)
+typedef std::function<void(const State *, State *, size_t, size_t)>
+    BlockSpanFunction;
+
+// Called with the input of each window and its number of blocks once the
+// window is processed
+typedef std::function<void(const State *, size_t)> WindowFunction;
+
+// Adds padding after length bytes of blocks, as StreamTransformationFilter
+// does at the end of encryption; returns the padded length
+size_t add_padding(State *blocks, size_t length, PaddingScheme padding_scheme) {
+  auto *bytes = reinterpret_cast<uint8_t *>(blocks);
+  size_t remainder = length % AES_BLOCK_SIZE_BYTES;
+  size_t padding = AES_BLOCK_SIZE_BYTES - remainder;
+
+  switch (padding_scheme) {
+    case CryptoPP::BlockPaddingSchemeDef::NO_PADDING:
+      if (remainder != 0)
+        throw CryptoPP::InvalidDataFormat(
+            "StreamTransformationFilter: plaintext length is not a multiple "
+            "of block size and NO_PADDING is specified");
+      return length;
+    case CryptoPP::BlockPaddingSchemeDef::ZEROS_PADDING:
+      if (remainder == 0) return length;
+      std::memset(bytes + length, 0, padding);
+      return length + padding;
+    case CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING:
+      std::memset(bytes + length, static_cast<int>(padding), padding);
+      return length + padding;
+    case CryptoPP::BlockPaddingSchemeDef::ONE_AND_ZEROS_PADDING:
+      bytes[length] = 0x80;
+      std::memset(bytes + length + 1, 0, padding - 1);
+      return length + padding;
+    default:
+      throw CryptoPP::InvalidArgument("Unsupported padding scheme");
+  }
+}
+
+// Removes padding from length bytes of decrypted blocks, rejecting it the
+// way StreamTransformationFilter does; returns the unpadded length
+size_t remove_padding(const State *blocks, size_t length,
+                      PaddingScheme padding_scheme) {
+  if (length % AES_BLOCK_SIZE_BYTES != 0)
+    throw CryptoPP::InvalidCiphertext(
+        "StreamTransformationFilter: ciphertext length is not a multiple of "
+        "block size");
+
+  switch (padding_scheme) {
+    case CryptoPP::BlockPaddingSchemeDef::NO_PADDING:
+    case CryptoPP::BlockPaddingSchemeDef::ZEROS_PADDING:
+      return length;
+    case CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING:
+    case CryptoPP::BlockPaddingSchemeDef::ONE_AND_ZEROS_PADDING:
+      break;
+    default:
+      throw CryptoPP::InvalidArgument("Unsupported padding scheme");
+  }
+
+  // The padding is always in the last block, which has to exist
+  if (length == 0)
+    throw CryptoPP::InvalidCiphertext(
+        "StreamTransformationFilter: ciphertext length is not a multiple of "
+        "block size");
+  const State &last_block = blocks[length / AES_BLOCK_SIZE_BYTES - 1];
+  size_t block_length = AES_BLOCK_SIZE_BYTES;
+
+  if (padding_scheme == CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING) {
+    uint8_t pad = last_block[AES_BLOCK_SIZE_BYTES - 1];
+    if (pad < 1 || pad > AES_BLOCK_SIZE_BYTES ||
+        std::any_of(last_block.end() - pad, last_block.end(),
+                    [pad](uint8_t b) { return b != pad; }))
+      throw CryptoPP::InvalidCiphertext(
+          "StreamTransformationFilter: invalid PKCS #7 block padding found");
+    block_length -= pad;
+  } else {
+    while (block_length > 1 && last_block[block_length - 1] == 0)
+      --block_length;
+    if (last_block[--block_length] != 0x80)
+      throw CryptoPP::InvalidCiphertext(
+          "StreamTransformationFilter: invalid ones-and-zeros padding found");
+  }
+
+  return length - AES_BLOCK_SIZE_BYTES + block_length;
+}
+
+// Reads the input in windows of whole blocks, runs process on them in
+// chunks on the pool and writes the results in order. The last window is
+// padded before or unpadded after processing, depending on encrypt.
+void run_block_mode_parallel(std::istream &input_stream,
+                             std::ostream &output_stream, bool encrypt,
+                             PaddingScheme padding_scheme, ThreadPool &pool,
+                             const BlockSpanFunction &process,
+                             const WindowFunction &end_window) {
+  if (padding_scheme == CryptoPP::BlockPaddingSchemeDef::DEFAULT_PADDING)
+    padding_scheme = CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING;
+
+  size_t window_blocks =
+      BLOCKS_PER_CHUNK * PARALLEL_CHUNKS_PER_THREAD * pool.numThreads();
+  // One spare block for the padding of the last window
+  std::vector<State> input(window_blocks + 1);
+  std::vector<State> output(window_blocks + 1);
+  const size_t window_size = window_blocks * AES_BLOCK_SIZE_BYTES;
+
+  for (bool last = false; !last;) {
+    input_stream.read(reinterpret_cast<char *>(input.data()), window_size);
+    auto length = static_cast<size_t>(input_stream.gcount());
+    last = length < window_size ||
+           input_stream.peek() == std::char_traits<char>::eof();
+
+    if (last && encrypt)
+      length = add_padding(input.data(), length, padding_scheme);
+    if (!encrypt && length % AES_BLOCK_SIZE_BYTES != 0)
+      throw CryptoPP::InvalidCiphertext(
+          "StreamTransformationFilter: ciphertext length is not a multiple of "
+          "block size");
+
+    size_t blocks = length / AES_BLOCK_SIZE_BYTES;
+    size_t num_chunks = (blocks + BLOCKS_PER_CHUNK - 1) / BLOCKS_PER_CHUNK;
+    pool.parallelFor(num_chunks, [&](size_t chunk) {
+      size_t begin = chunk * BLOCKS_PER_CHUNK;
+      process(input.data(), output.data(), begin,
+              std::min(BLOCKS_PER_CHUNK, blocks - begin));
+    });
+    end_window(input.data(), blocks);
+
+    if (last && !encrypt)
+      length = remove_padding(output.data(), length, padding_scheme);
+    output_stream.write(reinterpret_cast<const char *>(output.data()), length);
+  }
+}
+}  // namespace
+
+void apply_ctr_keystream(const WhiteBoxData &data, const State &iv,
+                         uint64_t first_block, uint8_t *buffer,
+                         size_t length) {
+  std::array<State, INTERPRETER_STAGING_BLOCKS> keystream;
+
+  while (length > 0) {
+    size_t blocks = std::min(
+        INTERPRETER_STAGING_BLOCKS,
+        (length + AES_BLOCK_SIZE_BYTES - 1) / AES_BLOCK_SIZE_BYTES);
+    interpret_white_box_ctr(data, iv, first_block, keystream.data(), blocks);
+
+    for (size_t i = 0; i < blocks; ++i) {
+      size_t block_length =
+          std::min(length, static_cast<size_t>(AES_BLOCK_SIZE_BYTES));
+      for (size_t j = 0; j < block_length; ++j) buffer[j] ^= keystream[i][j];
+      buffer += block_length;
+      length -= block_length;
+    }
+    first_block += blocks;
+  }
+}
+
+void encrypt_ctr_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data, const State &iv,
+                               ThreadPool &pool) {
+  std::vector<uint8_t> buffer(PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD *
+                              pool.numThreads());
+  uint64_t block_offset = 0;
+
+  while (input_stream) {
+    input_stream.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    auto length = static_cast<size_t>(input_stream.gcount());
+    if (length == 0) break;
+
+    size_t num_chunks = (length + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    pool.parallelFor(num_chunks, [&](size_t chunk) {
+      size_t begin = chunk * PARALLEL_CHUNK_SIZE;
+      apply_ctr_keystream(data, iv,
+                          block_offset + begin / AES_BLOCK_SIZE_BYTES,
+                          buffer.data() + begin,
+                          std::min(PARALLEL_CHUNK_SIZE, length - begin));
+    });
+
+    output_stream.write(reinterpret_cast<const char *>(buffer.data()), length);
+    // Only the last read can end in a partial block
+    block_offset += length / AES_BLOCK_SIZE_BYTES;
+  }
+}
+
+void decrypt_ctr_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data, const State &iv,
+                               ThreadPool &pool) {
+  // CTR decryption applies the same keystream as encryption
+  encrypt_ctr_mode_parallel(input_stream, output_stream, data, iv, pool);
+}
+
+uint64_t decrypt_ctr_range(const WhiteBoxData &data, const State &iv,
+                           uint64_t offset, uint64_t length,
+                           std::istream &input_stream,
+                           std::ostream &output_stream, ThreadPool *pool) {
+  constexpr auto max_offset = std::numeric_limits<std::streamoff>::max();
+  if (offset > static_cast<uint64_t>(max_offset))
+    throw CryptoPP::InvalidArgument(
+        "CTR: range offset does not fit into a stream offset");
+  input_stream.seekg(static_cast<std::streamoff>(offset));
+  if (!input_stream) {
+    input_stream.clear();
+    for (uint64_t skipped = 0; skipped < offset && input_stream;) {
+      auto step = static_cast<std::streamsize>(
+          std::min<uint64_t>(offset - skipped, PARALLEL_CHUNK_SIZE));
+      input_stream.ignore(step);
+      skipped += static_cast<uint64_t>(input_stream.gcount());
+    }
+  }
+
+  // The first window starts at the block of the offset; the bytes of that
+  // block before the offset are left out of the buffer
+  uint64_t block = offset / AES_BLOCK_SIZE_BYTES;
+  size_t skip = offset % AES_BLOCK_SIZE_BYTES;
+  size_t threads = (pool != nullptr) ? pool->numThreads() : 1;
+  const size_t window =
+      PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD * threads;
+  // Short ranges only get a buffer of their own size
+  size_t range_size =
+      skip + static_cast<size_t>(std::min<uint64_t>(length, window));
+  std::vector<uint8_t> buffer(
+      std::min(window, (range_size + AES_BLOCK_SIZE_BYTES - 1) /
+                           AES_BLOCK_SIZE_BYTES * AES_BLOCK_SIZE_BYTES));
+  uint64_t written = 0;
+
+  while (written < length && input_stream) {
+    input_stream.read(reinterpret_cast<char *>(buffer.data() + skip),
+                      static_cast<std::streamsize>(std::min<uint64_t>(
+                          buffer.size() - skip, length - written)));
+    auto read = static_cast<size_t>(input_stream.gcount());
+    if (read == 0) break;
+
+    size_t span = skip + read;
+    size_t num_chunks = (span + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    auto task = [&](size_t chunk) {
+      size_t begin = chunk * PARALLEL_CHUNK_SIZE;
+      apply_ctr_keystream(data, iv, block + begin / AES_BLOCK_SIZE_BYTES,
+                          buffer.data() + begin,
+                          std::min(PARALLEL_CHUNK_SIZE, span - begin));
+    };
+    if (pool != nullptr) {
+      pool->parallelFor(num_chunks, task);
+    } else {
+      for (size_t chunk = 0; chunk < num_chunks; ++chunk) task(chunk);
+    }
+
+    output_stream.write(reinterpret_cast<const char *>(buffer.data() + skip),
+                        static_cast<std::streamsize>(read));
+    written += read;
+    // Every window but the last ends on a block boundary
+    block += span / AES_BLOCK_SIZE_BYTES;
+    skip = 0;
+  }
+  return written;
+}
+
+void encrypt_ecb_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data,
+                               PaddingScheme padding_scheme, ThreadPool &pool) {
+  run_block_mode_parallel(
+      input_stream, output_stream, true, padding_scheme, pool,
+      [&](const State *input, State *output, size_t begin, size_t blocks) {
+        interpret_white_box_batch(data, input + begin, output + begin, blocks,
+                                  false);
+      },
+      [](const State *, size_t) {});
+}
+
+void decrypt_ecb_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data,
+                               PaddingScheme padding_scheme, ThreadPool &pool) {
+  run_block_mode_parallel(
+      input_stream, output_stream, false, padding_scheme, pool,
+      [&](const State *input, State *output, size_t begin, size_t blocks) {
+        interpret_white_box_batch(data, input + begin, output + begin, blocks,
+                                  true);
+      },
+      [](const State *, size_t) {});
+}
+
+void decrypt_cbc_mode_parallel(std::istream &input_stream,
+                               std::ostream &output_stream,
+                               const WhiteBoxData &data, const State &iv,
+                               PaddingScheme padding_scheme, ThreadPool &pool) {
+  // Last ciphertext block of the previous window
+  State chain = iv;
+
+  run_block_mode_parallel(
+      input_stream, output_stream, false, padding_scheme, pool,
+      [&](const State *input, State *output, size_t begin, size_t blocks) {
+        interpret_white_box_batch(data, input + begin, output + begin, blocks,
+                                  true);
+        // P_i = D(C_i) ^ C_(i - 1)
+        for (size_t i = begin; i < begin + blocks; ++i)
+          output[i] = output[i] ^ ((i == 0) ? chain : input[i - 1]);
+      },
+      [&](const State *input, size_t blocks) {
+        if (blocks > 0) chain = input[blocks - 1];
+      });
+}
+}  // namespace WhiteBox
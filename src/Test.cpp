@@ -2,17 +2,34 @@
 // Created by Christoph Kummer on 26.02.19.
 //
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
 
 #include <NTL/GF2E.h>
 #include <NTL/GF2X.h>
 #include <cryptopp/osrng.h>
 
+#include <CtrContext.h>
+#include <GcmMode.h>
+#include <ParallelModes.h>
 #include <RandomPermutation.h>
+#include <ThreadPool.h>
 #include <WhiteBoxInterpreter.h>
+#include <WhiteBoxStorage.h>
 #include <WhiteBoxTableGenerator.h>
+#include <XtsMode.h>
 
 // This file mostly includes test vectors to ensure
 // that the implementation works as expected
@@ -34,6 +51,48 @@ void test_vectors_protected_decryption();
 
 void test_vectors_protected_mixing_decryption();
 
+void test_vectors_batch();
+
+void test_vectors_packed_xor_tables();
+
+void test_vectors_sse4();
+
+void test_vectors_avx2();
+
+void test_vectors_interpreter_backends();
+
+void test_vectors_avx512();
+
+void test_vectors_binary_table();
+
+void test_vectors_compact_tables();
+
+void test_vectors_byte_xor_tables();
+
+void test_vectors_plain_xor_tables();
+
+void test_vectors_warm_tables();
+
+void test_vectors_huge_pages();
+
+void test_vectors_parallel_ctr();
+
+void test_vectors_ctr_lookahead();
+
+void test_vectors_ctr_memoization();
+
+void test_vectors_ctr_range();
+
+void test_vectors_gcm();
+
+void test_vectors_xts();
+
+void test_vectors_parallel_cbc_decryption();
+
+void test_vectors_parallel_generation();
+
+void test_vectors_single_direction_generation();
+
 bool run_test_vector_unprotected(const std::string &plain,
                                  const std::string &key,
                                  const std::string &cipher) {
@@ -206,6 +265,874 @@ bool run_test_vector_protected_mixing_decryption(const std::string &cipher,
   return false;
 }
 
+// Signature shared by the multi-block interpreters
+typedef void (*BatchInterpreter)(const WhiteBoxData &, const State *, State *,
+                                 size_t, bool, size_t);
+
+bool run_test_vectors_batch(
+    const std::string &key, const std::array<std::string, 3> &plain,
+    const std::array<std::string, 3> &cipher, bool pack_xor_tables,
+    BatchInterpreter interpret_batch = interpret_white_box_batch) {
+  State key_state;
+  std::array<State, 3> plain_states;
+  std::array<State, 3> cipher_states;
+
+  if (!parse_aes_state(key_state, key)) return false;
+  for (size_t i = 0; i < 3; ++i) {
+    if (!parse_aes_state(plain_states[i], plain[i]) ||
+        !parse_aes_state(cipher_states[i], cipher[i]))
+      return false;
+  }
+
+  std::unique_ptr<WhiteBoxTableGenerator> table(
+      new WhiteBoxTableGenerator(key_state, true, true));
+  std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+  std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+  if (pack_xor_tables) {
+    encryption_data->packXorTables();
+    decryption_data->packXorTables();
+  }
+
+  // Not a multiple of any batch size, so that partial batches are run as well
+  constexpr size_t num_blocks = 2 * AVX512_BATCH_SIZE + 3;
+  std::vector<State> input(num_blocks);
+  std::vector<State> output(num_blocks);
+  for (size_t i = 0; i < num_blocks; ++i) input[i] = plain_states[i % 3];
+
+  interpret_batch(*encryption_data, input.data(), output.data(), num_blocks,
+                  false, 0);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    if (output[i] != cipher_states[i % 3]) return false;
+  }
+
+  // Decrypt in place
+  interpret_batch(*decryption_data, output.data(), output.data(), num_blocks,
+                  true, 0);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    if (output[i] != plain_states[i % 3]) return false;
+  }
+
+  return true;
+}
+
+// Write the table to a temporary binary table file and map it back
+WhiteBoxDataPtr round_trip_binary_table(const WhiteBoxData &data,
+                                        bool huge_pages = false) {
+  char path[] = "/tmp/whitebox_tableXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) return nullptr;
+  close(fd);
+
+  WhiteBoxDataPtr mapped;
+  std::ofstream ofs(path, std::ios::out | std::ios::binary);
+  if (write_binary_table(data, ofs)) {
+    ofs.close();
+    if (is_binary_table_file(path))
+      mapped = map_binary_table(path, huge_pages);
+  }
+  // The mapping stays valid after the file is removed
+  unlink(path);
+  return mapped;
+}
+
+bool run_test_vector_binary_table(const std::string &plain,
+                                  const std::string &key,
+                                  const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    std::unique_ptr<WhiteBoxTableGenerator> table(
+        new WhiteBoxTableGenerator(key_state, true, true));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+
+    WhiteBoxDataPtr mapped_encryption = round_trip_binary_table(*encryption_data);
+    WhiteBoxDataPtr mapped_decryption = round_trip_binary_table(*decryption_data);
+    if (!mapped_encryption || !mapped_decryption) return false;
+
+    return interpret_white_box(*mapped_encryption, state, false) ==
+               cipher_state &&
+           interpret_white_box(*mapped_decryption, cipher_state, true) == state;
+  }
+
+  return false;
+}
+
+bool run_test_vector_compact_tables(const std::string &plain,
+                                    const std::string &key,
+                                    const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    std::unique_ptr<WhiteBoxTableGenerator> table(
+        new WhiteBoxTableGenerator(key_state, true, false));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+
+    // Without mixing bijections, the binary file ends before the mixing
+    // tables
+    std::ostringstream binary;
+    if (!write_binary_table(*encryption_data, binary)) return false;
+    BinaryTableHeader header{};
+    std::memcpy(&header, binary.str().data(), sizeof(header));
+    if (header.dataSize_ != offsetof(WhiteBoxData, mixingTables_) ||
+        binary.str().size() != header.dataOffset_ + header.dataSize_)
+      return false;
+
+    // and neither are they part of the text archive
+    std::stringstream text;
+    {
+      boost::archive::text_oarchive oarchive(text);
+      oarchive << *decryption_data;
+    }
+    WhiteBoxDataPtr loaded_decryption = allocate_white_box_data();
+    boost::archive::text_iarchive iarchive(text);
+    iarchive >> *loaded_decryption;
+
+    WhiteBoxDataPtr mapped_encryption = round_trip_binary_table(*encryption_data);
+    if (!mapped_encryption) return false;
+
+    return interpret_white_box(*mapped_encryption, state, false) ==
+               cipher_state &&
+           interpret_white_box(*loaded_decryption, cipher_state, true) ==
+               state;
+  }
+
+  return false;
+}
+
+bool run_test_vector_byte_xor_tables(const std::string &plain,
+                                     const std::string &key,
+                                     const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (!parse_aes_state(state, plain) || !parse_aes_state(key_state, key) ||
+      !parse_aes_state(cipher_state, cipher))
+    return false;
+
+  for (bool use_mixing : {false, true}) {
+    std::unique_ptr<WhiteBoxTableGenerator> table(new WhiteBoxTableGenerator(
+        key_state, true, use_mixing, TableDirection::BOTH, nullptr,
+        TableGranularity::BYTE));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+    if (encryption_data->xorGranularity_ != TableGranularity::BYTE)
+      return false;
+
+    std::vector<State> states(INTERPRETER_BATCH_SIZE + 1, state);
+    interpret_white_box_batch(*encryption_data, states.data(), states.data(),
+                              states.size(), false);
+    for (const auto &output : states)
+      if (output != cipher_state) return false;
+
+    // The granularity is recorded in the binary format, the byte tables
+    // are derived again when mapping
+    WhiteBoxDataPtr mapped_decryption =
+        round_trip_binary_table(*decryption_data);
+    if (!mapped_decryption ||
+        mapped_decryption->xorGranularity_ != TableGranularity::BYTE)
+      return false;
+
+    if (interpret_white_box(*encryption_data, state, false) != cipher_state ||
+        interpret_white_box(*mapped_decryption, cipher_state, true) != state)
+      return false;
+  }
+
+  return true;
+}
+
+bool run_test_vectors_plain_xor_tables(const std::string &key,
+                                       const std::string &plain,
+                                       const std::string &cipher) {
+  State key_state;
+  State plain_state;
+  State cipher_state;
+  if (!parse_aes_state(key_state, key) ||
+      !parse_aes_state(plain_state, plain) ||
+      !parse_aes_state(cipher_state, cipher))
+    return false;
+
+  std::unique_ptr<WhiteBoxTableGenerator> table(
+      new WhiteBoxTableGenerator(key_state, false, true));
+  std::unique_ptr<WhiteBoxData> plain_data(table->getEncryptionTable());
+  if (!plain_data->usesPlainXorTables_) return false;
+  // Same tables, looked up instead of XORed directly
+  std::unique_ptr<WhiteBoxData> table_data(new WhiteBoxData(*plain_data));
+  table_data->usesPlainXorTables_ = false;
+
+  constexpr size_t num_blocks = AVX512_BATCH_SIZE + 3;
+  std::vector<State> input(num_blocks, plain_state);
+  for (size_t i = 0; i < num_blocks; ++i)
+    input[i][15] = static_cast<uint8_t>(input[i][15] ^ i);
+  std::vector<State> expected(num_blocks);
+  interpret_white_box_batch_scalar(*table_data, input.data(), expected.data(),
+                                   num_blocks, false);
+  if (expected[0] != cipher_state) return false;
+
+  std::vector<std::pair<bool (*)(), BatchInterpreter>> backends = {
+      {[] { return true; }, interpret_white_box_batch_scalar},
+      {cpu_supports_sse4, interpret_white_box_batch_sse4},
+      {cpu_supports_avx2, interpret_white_box_batch_avx2},
+      {cpu_supports_avx512_vbmi, interpret_white_box_batch_avx512}};
+  std::vector<State> output(num_blocks);
+  for (const auto &backend : backends) {
+    if (!backend.first()) continue;
+    backend.second(*plain_data, input.data(), output.data(), num_blocks,
+                   false, 0);
+    if (output != expected) return false;
+  }
+
+  // The flag survives the binary format
+  WhiteBoxDataPtr mapped = round_trip_binary_table(*plain_data);
+  return mapped && mapped->usesPlainXorTables_ &&
+         interpret_white_box(*mapped, plain_state, false) == cipher_state;
+}
+
+bool run_test_vector_warm_tables(const std::string &plain,
+                                 const std::string &key,
+                                 const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    std::unique_ptr<WhiteBoxTableGenerator> table(new WhiteBoxTableGenerator(
+        key_state, true, true, TableDirection::ENCRYPTION));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    WhiteBoxDataPtr mapped = round_trip_binary_table(*encryption_data);
+    if (!mapped) return false;
+
+    // Locking is left out, it depends on the memlock limit of the host
+    ThreadPool pool(2);
+    WarmOptions options;
+    options.dummyBlocks_ = INTERPRETER_STAGING_BLOCKS;
+    options.pool_ = &pool;
+    if (!warm(*mapped, options)) return false;
+
+    // The dummy blocks rely on every thread running exactly once
+    std::vector<std::thread::id> threads(pool.numThreads());
+    pool.runOnEachThread(
+        [&](size_t index) { threads[index] = std::this_thread::get_id(); });
+    if (threads[0] != std::this_thread::get_id() ||
+        threads[0] == threads[1] || threads[1] == std::thread::id())
+      return false;
+
+    return interpret_white_box(*mapped, state, false) == cipher_state;
+  }
+
+  return false;
+}
+
+bool run_test_vector_huge_pages(const std::string &plain,
+                                const std::string &key,
+                                const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    std::unique_ptr<WhiteBoxTableGenerator> table(
+        new WhiteBoxTableGenerator(key_state, true, true));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+
+    // Hosts without reserved huge pages take the fallback, which has to
+    // work just the same
+    WhiteBoxDataPtr allocated = allocate_white_box_data(true);
+    WhiteBoxDataPtr mapped = round_trip_binary_table(*decryption_data, true);
+    if (!allocated || !mapped) return false;
+    *allocated = *encryption_data;
+
+    return interpret_white_box(*allocated, state, false) == cipher_state &&
+           interpret_white_box(*mapped, cipher_state, true) == state;
+  }
+
+  return false;
+}
+
+// Concatenates the blocks of a test vector, each given in hexadecimal
+bool parse_aes_blocks(std::string &bytes,
+                      const std::array<std::string, 4> &blocks) {
+  bytes.clear();
+  for (const auto &block : blocks) {
+    State state;
+    if (!parse_aes_state(state, block)) return false;
+    bytes.append(state.begin(), state.end());
+  }
+  return true;
+}
+
+bool run_test_vectors_parallel_ctr(const std::string &key,
+                                   const std::string &iv,
+                                   const std::array<std::string, 4> &plain,
+                                   const std::array<std::string, 4> &cipher) {
+  State key_state;
+  State iv_state;
+  std::string plain_text;
+  std::string cipher_text;
+
+  if (!parse_aes_state(key_state, key) || !parse_aes_state(iv_state, iv) ||
+      !parse_aes_blocks(plain_text, plain) ||
+      !parse_aes_blocks(cipher_text, cipher))
+    return false;
+  // Partial last block
+  plain_text.pop_back();
+  cipher_text.pop_back();
+
+  std::unique_ptr<WhiteBoxTableGenerator> table(
+      new WhiteBoxTableGenerator(key_state, true, true));
+  std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+
+  ThreadPool pool(3);
+  std::istringstream input(plain_text);
+  std::ostringstream output;
+  encrypt_ctr_mode_parallel(input, output, *encryption_data, iv_state, pool);
+  if (output.str() != cipher_text) return false;
+
+  std::istringstream cipher_input(cipher_text);
+  std::ostringstream plain_output;
+  decrypt_ctr_mode_parallel(cipher_input, plain_output, *encryption_data,
+                            iv_state, pool);
+  if (plain_output.str() != plain_text) return false;
+
+  // More than one window, ending in a partial block, against the
+  // single-threaded mode
+  std::string long_text(
+      PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD * pool.numThreads() + 37,
+      '\0');
+  for (size_t i = 0; i < long_text.size(); ++i)
+    long_text[i] = static_cast<char>(i * 7 + (i >> 8U));
+  std::istringstream expected_input(long_text);
+  std::ostringstream expected_output;
+  encrypt_ctr_mode(expected_input, expected_output, encryption_data.get(),
+                   iv_state, CryptoPP::BlockPaddingSchemeDef::NO_PADDING);
+  std::istringstream long_input(long_text);
+  std::ostringstream long_output;
+  encrypt_ctr_mode_parallel(long_input, long_output, *encryption_data,
+                            iv_state, pool);
+  return expected_output.str().size() == long_text.size() &&
+         long_output.str() == expected_output.str();
+}
+
+bool run_test_vectors_ctr_lookahead(const std::string &key,
+                                    const std::string &iv,
+                                    const std::array<std::string, 4> &plain,
+                                    const std::array<std::string, 4> &cipher) {
+  State key_state;
+  State iv_state;
+  std::string plain_blocks;
+  std::string cipher_blocks;
+
+  if (!parse_aes_state(key_state, key) || !parse_aes_state(iv_state, iv) ||
+      !parse_aes_blocks(plain_blocks, plain) ||
+      !parse_aes_blocks(cipher_blocks, cipher))
+    return false;
+  std::vector<uint8_t> plain_text(plain_blocks.begin(), plain_blocks.end());
+  std::vector<uint8_t> cipher_text(cipher_blocks.begin(), cipher_blocks.end());
+
+  std::unique_ptr<WhiteBoxTableGenerator> table(
+      new WhiteBoxTableGenerator(key_state, true, true));
+  std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+
+  // Pieces that end inside blocks, with a lookahead shorter than the
+  // message so the ring is refilled while it is read
+  std::vector<uint8_t> output(plain_text.size());
+  {
+    CtrContext context(*encryption_data, iv_state, 2);
+    const size_t pieces[] = {1, 17, 30, 15, 1};
+    size_t offset = 0;
+    for (size_t piece : pieces) {
+      context.process(plain_text.data() + offset, output.data() + offset,
+                      piece);
+      offset += piece;
+    }
+    if (context.position() != plain_text.size()) return false;
+  }
+  if (output != cipher_text) return false;
+
+  // In place, with the default lookahead
+  {
+    CtrContext context(*encryption_data, iv_state);
+    context.process(output.data(), output.data(), output.size());
+  }
+  if (output != plain_text) return false;
+
+  // A stream many times the lookahead has to match apply_ctr_keystream
+  std::vector<uint8_t> stream(5000);
+  for (size_t i = 0; i < stream.size(); ++i)
+    stream[i] = static_cast<uint8_t>(i * 7);
+  std::vector<uint8_t> expected = stream;
+  apply_ctr_keystream(*encryption_data, iv_state, 0, expected.data(),
+                      expected.size());
+  CtrContext context(*encryption_data, iv_state, 8);
+  for (size_t offset = 0, piece = 1; offset < stream.size();
+       offset += piece, piece = piece % 97 + 13) {
+    piece = std::min(piece, stream.size() - offset);
+    context.process(stream.data() + offset, stream.data() + offset, piece);
+  }
+  return stream == expected;
+}
+
+// Compares the memoized CTR interpreter with interpret_white_box on the
+// counter blocks, on every backend and XOR table layout
+bool run_test_vectors_ctr_memoization(const std::string &key,
+                                      const std::string &iv) {
+  State key_state;
+  State iv_state;
+  if (!parse_aes_state(key_state, key) || !parse_aes_state(iv_state, iv))
+    return false;
+
+  // Encoded tables with mixing, with nibble and with byte XOR tables, then
+  // plain XOR tables without
+  std::unique_ptr<WhiteBoxData> encoded_data(
+      WhiteBoxTableGenerator(key_state, true, true).getEncryptionTable());
+  std::unique_ptr<WhiteBoxData> byte_data(
+      WhiteBoxTableGenerator(key_state, true, true, TableDirection::ENCRYPTION,
+                             nullptr, TableGranularity::BYTE)
+          .getEncryptionTable());
+  std::unique_ptr<WhiteBoxData> plain_data(
+      WhiteBoxTableGenerator(key_state, false, false).getEncryptionTable());
+  if (!plain_data->usesPlainXorTables_) return false;
+
+  // Starts inside a run of 256 counters and carries into several bytes
+  constexpr uint64_t first_block = 5;
+  constexpr size_t num_blocks = 600;
+  std::vector<State> output(num_blocks);
+
+  bool has_succeeded = true;
+  for (const char *name : {"scalar", "sse4", "avx2", "avx512"}) {
+    InterpreterBackend backend;
+    if (!parse_interpreter_backend(backend, name)) has_succeeded = false;
+    if (!has_succeeded || !select_interpreter_backend(backend)) continue;
+
+    for (WhiteBoxData *data :
+         {encoded_data.get(), byte_data.get(), plain_data.get()}) {
+      interpret_white_box_ctr(*data, iv_state, first_block, output.data(),
+                              num_blocks);
+      for (size_t i = 0; i < num_blocks; ++i) {
+        State counter = add_to_counter(iv_state, first_block + i);
+        if (output[i] != interpret_white_box(*data, counter, false))
+          has_succeeded = false;
+      }
+    }
+  }
+  select_interpreter_backend(InterpreterBackend::AUTO);
+  if (!has_succeeded) return false;
+
+  // The same with packed XOR tables
+  encoded_data->packXorTables();
+  interpret_white_box_ctr(*encoded_data, iv_state, first_block, output.data(),
+                          num_blocks);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    State counter = add_to_counter(iv_state, first_block + i);
+    if (output[i] != interpret_white_box(*encoded_data, counter, false))
+      return false;
+  }
+  return true;
+}
+
+bool parse_hex_bytes(std::vector<uint8_t> &bytes, const std::string &hex) {
+  if (hex.size() % 2 != 0) return false;
+  bytes.clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    char *p;
+    std::string byte_string = hex.substr(i, 2);
+    bytes.push_back(
+        static_cast<uint8_t>(std::strtoul(byte_string.c_str(), &p, 16)));
+    if (*p != '\0') return false;
+  }
+  return true;
+}
+
+// Checks a GCM test vector with the buffer and the stream functions, and
+// that a changed ciphertext or tag is rejected
+bool run_test_vector_gcm(const std::string &key, const std::string &iv,
+                         const std::string &aad, const std::string &plain,
+                         const std::string &cipher, const std::string &tag) {
+  State key_state;
+  std::vector<uint8_t> iv_bytes, aad_bytes, plain_text, cipher_text, tag_bytes;
+  if (!parse_aes_state(key_state, key) || !parse_hex_bytes(iv_bytes, iv) ||
+      !parse_hex_bytes(aad_bytes, aad) ||
+      !parse_hex_bytes(plain_text, plain) ||
+      !parse_hex_bytes(cipher_text, cipher) || !parse_hex_bytes(tag_bytes, tag))
+    return false;
+
+  std::unique_ptr<WhiteBoxData> encryption_data(
+      WhiteBoxTableGenerator(key_state, true, true).getEncryptionTable());
+
+  std::vector<uint8_t> output(plain_text.size());
+  std::array<uint8_t, GCM_TAG_SIZE> output_tag;
+  encrypt_gcm(*encryption_data, iv_bytes.data(), iv_bytes.size(),
+              aad_bytes.data(), aad_bytes.size(), plain_text.data(),
+              output.data(), output.size(), output_tag.data());
+  if (output != cipher_text ||
+      !std::equal(output_tag.begin(), output_tag.end(), tag_bytes.begin()))
+    return false;
+
+  if (!decrypt_gcm(*encryption_data, iv_bytes.data(), iv_bytes.size(),
+                   aad_bytes.data(), aad_bytes.size(), output.data(),
+                   output.data(), output.size(), tag_bytes.data()) ||
+      output != plain_text)
+    return false;
+
+  std::vector<uint8_t> tampered = cipher_text;
+  if (!tampered.empty()) tampered.back() ^= 1;
+  tampered.insert(tampered.end(), tag_bytes.begin(), tag_bytes.end());
+  if (cipher_text.empty()) tampered.back() ^= 1;
+  if (decrypt_gcm(*encryption_data, iv_bytes.data(), iv_bytes.size(),
+                  aad_bytes.data(), aad_bytes.size(), tampered.data(),
+                  output.data(), output.size(),
+                  tampered.data() + cipher_text.size()))
+    return false;
+  if (std::any_of(output.begin(), output.end(),
+                  [](uint8_t byte) { return byte != 0; }))
+    return false;
+
+  // The stream functions write and read the tag after the ciphertext
+  std::string sealed(cipher_text.begin(), cipher_text.end());
+  sealed.append(tag_bytes.begin(), tag_bytes.end());
+  std::istringstream input(std::string(plain_text.begin(), plain_text.end()));
+  std::ostringstream sealed_output;
+  encrypt_gcm_mode(input, sealed_output, *encryption_data, iv_bytes.data(),
+                   iv_bytes.size(), aad_bytes.data(), aad_bytes.size(),
+                   nullptr);
+  if (sealed_output.str() != sealed) return false;
+
+  std::istringstream sealed_input(sealed);
+  std::ostringstream plain_output;
+  decrypt_gcm_mode(sealed_input, plain_output, *encryption_data,
+                   iv_bytes.data(), iv_bytes.size(), aad_bytes.data(),
+                   aad_bytes.size(), nullptr);
+  if (plain_output.str() != std::string(plain_text.begin(), plain_text.end()))
+    return false;
+
+  std::istringstream tampered_input(
+      std::string(tampered.begin(), tampered.end()));
+  std::ostringstream discarded;
+  try {
+    decrypt_gcm_mode(tampered_input, discarded, *encryption_data,
+                     iv_bytes.data(), iv_bytes.size(), aad_bytes.data(),
+                     aad_bytes.size(), nullptr);
+    return false;
+  } catch (CryptoPP::HashVerificationFilter::HashVerificationFailed &) {
+  }
+  // A message of a single window is not released before its tag is checked
+  return discarded.str().empty();
+}
+
+// A stream over several windows on a pool, against the buffer function, and
+// the PCLMUL GHASH kernel against the scalar one
+bool run_test_vectors_gcm_parallel(const std::string &key) {
+  State key_state;
+  if (!parse_aes_state(key_state, key)) return false;
+  std::unique_ptr<WhiteBoxData> encryption_data(
+      WhiteBoxTableGenerator(key_state, false, false).getEncryptionTable());
+
+  const uint8_t iv[12] = {0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce,
+                          0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88};
+  const uint8_t aad[5] = {1, 2, 3, 4, 5};
+  ThreadPool pool(3);
+  // Not a multiple of the block size, and more than one window
+  std::string plain_text(2 * PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD *
+                                 pool.numThreads() +
+                             1000,
+                         '\0');
+  for (size_t i = 0; i < plain_text.size(); ++i)
+    plain_text[i] = static_cast<char>(i * 31 + (i >> 8));
+
+  std::vector<uint8_t> expected(plain_text.size() + GCM_TAG_SIZE);
+  encrypt_gcm(*encryption_data, iv, sizeof(iv), aad, sizeof(aad),
+              reinterpret_cast<const uint8_t *>(plain_text.data()),
+              expected.data(), plain_text.size(),
+              expected.data() + plain_text.size());
+
+  std::istringstream input(plain_text);
+  std::ostringstream output;
+  encrypt_gcm_mode(input, output, *encryption_data, iv, sizeof(iv), aad,
+                   sizeof(aad), &pool);
+  if (output.str() != std::string(expected.begin(), expected.end()))
+    return false;
+
+  std::istringstream cipher_input(output.str());
+  std::ostringstream plain_output;
+  decrypt_gcm_mode(cipher_input, plain_output, *encryption_data, iv,
+                   sizeof(iv), aad, sizeof(aad), &pool);
+  if (plain_output.str() != plain_text) return false;
+
+  if (cpu_supports_pclmul()) {
+    GhashKey ghash_key(interpret_white_box(*encryption_data, State{}, false));
+    State scalar_y{};
+    State pclmul_y{};
+    size_t blocks = expected.size() / AES_BLOCK_SIZE_BYTES;
+    ghash_blocks_scalar(ghash_key, scalar_y, expected.data(), blocks);
+    ghash_blocks_pclmul(ghash_key, pclmul_y, expected.data(), blocks);
+    if (scalar_y != pclmul_y) return false;
+  }
+  return true;
+}
+
+// Encrypts and decrypts one XTS sector of the length of the plaintext
+bool run_test_vector_xts(const std::string &data_key,
+                         const std::string &tweak_key, uint64_t sector,
+                         const std::string &plain, const std::string &cipher) {
+  State data_key_state;
+  State tweak_key_state;
+  std::vector<uint8_t> plain_text;
+  std::vector<uint8_t> cipher_text;
+  if (!parse_aes_state(data_key_state, data_key) ||
+      !parse_aes_state(tweak_key_state, tweak_key) ||
+      !parse_hex_bytes(plain_text, plain) ||
+      !parse_hex_bytes(cipher_text, cipher))
+    return false;
+
+  WhiteBoxTableGenerator data_table(data_key_state, true, true);
+  std::unique_ptr<WhiteBoxData> encryption_data(
+      data_table.getEncryptionTable());
+  std::unique_ptr<WhiteBoxData> decryption_data(
+      data_table.getDecryptionTable());
+  std::unique_ptr<WhiteBoxData> tweak_data(
+      WhiteBoxTableGenerator(tweak_key_state, true, true,
+                             TableDirection::ENCRYPTION)
+          .getEncryptionTable());
+
+  std::vector<uint8_t> output(plain_text.size());
+  encrypt_xts_sectors(*encryption_data, *tweak_data, sector,
+                      plain_text.size(), plain_text.data(), output.data(),
+                      output.size(), nullptr);
+  if (output != cipher_text) return false;
+
+  decrypt_xts_sectors(*decryption_data, *tweak_data, sector, output.size(),
+                      output.data(), output.data(), output.size(), nullptr);
+  return output == plain_text;
+}
+
+// Many sectors on a pool, with ciphertext stealing in every sector and a
+// short last one, against sectors encrypted one at a time
+bool run_test_vectors_xts_parallel(const std::string &data_key,
+                                   const std::string &tweak_key) {
+  State data_key_state;
+  State tweak_key_state;
+  if (!parse_aes_state(data_key_state, data_key) ||
+      !parse_aes_state(tweak_key_state, tweak_key))
+    return false;
+
+  WhiteBoxTableGenerator data_table(data_key_state, false, false);
+  std::unique_ptr<WhiteBoxData> encryption_data(
+      data_table.getEncryptionTable());
+  std::unique_ptr<WhiteBoxData> decryption_data(
+      data_table.getDecryptionTable());
+  std::unique_ptr<WhiteBoxData> tweak_data(
+      WhiteBoxTableGenerator(tweak_key_state, false, false,
+                             TableDirection::ENCRYPTION)
+          .getEncryptionTable());
+
+  constexpr size_t sector_size = 4100;
+  constexpr uint64_t first_sector = 7;
+  std::vector<uint8_t> plain_text(300 * sector_size + 21);
+  for (size_t i = 0; i < plain_text.size(); ++i)
+    plain_text[i] = static_cast<uint8_t>(i * 13 + (i >> 9));
+
+  std::vector<uint8_t> expected(plain_text.size());
+  for (size_t begin = 0; begin < plain_text.size(); begin += sector_size) {
+    size_t length = std::min(sector_size, plain_text.size() - begin);
+    encrypt_xts_sectors(*encryption_data, *tweak_data,
+                        first_sector + begin / sector_size, sector_size,
+                        plain_text.data() + begin, expected.data() + begin,
+                        length, nullptr);
+  }
+
+  ThreadPool pool(3);
+  std::vector<uint8_t> output(plain_text.size());
+  encrypt_xts_sectors(*encryption_data, *tweak_data, first_sector,
+                      sector_size, plain_text.data(), output.data(),
+                      output.size(), &pool);
+  if (output != expected) return false;
+
+  // The stream is read in several windows
+  std::istringstream input(std::string(plain_text.begin(), plain_text.end()));
+  std::ostringstream cipher_output;
+  encrypt_xts_mode(input, cipher_output, *encryption_data, *tweak_data,
+                   first_sector, sector_size, &pool);
+  if (cipher_output.str() != std::string(expected.begin(), expected.end()))
+    return false;
+
+  std::istringstream cipher_input(cipher_output.str());
+  std::ostringstream plain_output;
+  decrypt_xts_mode(cipher_input, plain_output, *decryption_data, *tweak_data,
+                   first_sector, sector_size, &pool);
+  return plain_output.str() ==
+         std::string(plain_text.begin(), plain_text.end());
+}
+
+// A stream buffer without seeking, like that of a pipe
+class ForwardOnlyBuffer : public std::streambuf {
+ public:
+  explicit ForwardOnlyBuffer(std::string &data) {
+    setg(&data[0], &data[0], &data[0] + data.size());
+  }
+};
+
+// Decrypts ranges of a CTR stream and compares them with the same bytes of
+// the whole decrypted stream
+bool run_test_vectors_ctr_range(const std::string &key,
+                                const std::string &iv) {
+  State key_state;
+  State iv_state;
+  if (!parse_aes_state(key_state, key) || !parse_aes_state(iv_state, iv))
+    return false;
+  std::unique_ptr<WhiteBoxData> encryption_data(
+      WhiteBoxTableGenerator(key_state, false, false).getEncryptionTable());
+
+  ThreadPool pool(3);
+  // Longer than a window of the pool
+  std::string plain_text(PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD *
+                                 pool.numThreads() +
+                             5003,
+                         '\0');
+  for (size_t i = 0; i < plain_text.size(); ++i)
+    plain_text[i] = static_cast<char>(i * 11 + (i >> 10));
+  std::string cipher_text = plain_text;
+  apply_ctr_keystream(*encryption_data, iv_state, 0,
+                      reinterpret_cast<uint8_t *>(&cipher_text[0]),
+                      cipher_text.size());
+
+  const uint64_t size = plain_text.size();
+  // Aligned and unaligned ends, ranges past the end and the whole stream
+  const std::pair<uint64_t, uint64_t> ranges[] = {
+      {0, 16},         {5, 3},          {17, 4096},
+      {4090, 100},     {1000, 800000},  {size - 20, 100},
+      {size + 10, 16}, {33, 0},         {0, size},
+      {7, UINT64_MAX}};
+  for (const auto &range : ranges) {
+    uint64_t offset = range.first;
+    uint64_t expected_length =
+        (offset < size) ? std::min(range.second, size - offset) : 0;
+    std::string expected =
+        (offset < size) ? plain_text.substr(offset, expected_length) : "";
+
+    for (ThreadPool *range_pool :
+         {static_cast<ThreadPool *>(nullptr), &pool}) {
+      std::istringstream input(cipher_text);
+      std::ostringstream output;
+      if (decrypt_ctr_range(*encryption_data, iv_state, offset, range.second,
+                            input, output, range_pool) != expected_length ||
+          output.str() != expected)
+        return false;
+    }
+
+    ForwardOnlyBuffer buffer(cipher_text);
+    std::istream forward_input(&buffer);
+    std::ostringstream output;
+    decrypt_ctr_range(*encryption_data, iv_state, offset, range.second,
+                      forward_input, output, nullptr);
+    if (output.str() != expected) return false;
+  }
+
+  // Offsets a stream cannot seek to are rejected instead of read through
+  std::istringstream input(cipher_text);
+  std::ostringstream output;
+  try {
+    decrypt_ctr_range(*encryption_data, iv_state, uint64_t{1} << 63U, 16,
+                      input, output, nullptr);
+    return false;
+  } catch (CryptoPP::InvalidArgument &) {
+  }
+  return true;
+}
+
+bool run_test_vectors_parallel_cbc_decryption(
+    const std::string &key, const std::string &iv,
+    const std::array<std::string, 4> &plain,
+    const std::array<std::string, 4> &cipher) {
+  State key_state;
+  State iv_state;
+  std::string plain_text;
+  std::string cipher_text;
+
+  if (!parse_aes_state(key_state, key) || !parse_aes_state(iv_state, iv) ||
+      !parse_aes_blocks(plain_text, plain) ||
+      !parse_aes_blocks(cipher_text, cipher))
+    return false;
+
+  std::unique_ptr<WhiteBoxTableGenerator> table(
+      new WhiteBoxTableGenerator(key_state, true, true));
+  std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+
+  ThreadPool pool(3);
+  std::istringstream input(cipher_text);
+  std::ostringstream output;
+  decrypt_cbc_mode_parallel(input, output, *decryption_data, iv_state,
+                            CryptoPP::BlockPaddingSchemeDef::NO_PADDING, pool);
+  return output.str() == plain_text;
+}
+
+bool run_test_vector_parallel_generation(const std::string &plain,
+                                         const std::string &key,
+                                         const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    ThreadPool pool(3);
+    std::unique_ptr<WhiteBoxTableGenerator> table(
+        new WhiteBoxTableGenerator(key_state, true, true,
+                                   TableDirection::BOTH, &pool));
+    std::unique_ptr<WhiteBoxData> encryption_data(table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(table->getDecryptionTable());
+
+    return interpret_white_box(*encryption_data, state, false) ==
+               cipher_state &&
+           interpret_white_box(*decryption_data, cipher_state, true) == state;
+  }
+
+  return false;
+}
+
+bool run_test_vector_single_direction_generation(const std::string &plain,
+                                                const std::string &key,
+                                                const std::string &cipher) {
+  State state;
+  State key_state;
+  State cipher_state;
+
+  if (parse_aes_state(state, plain) && parse_aes_state(key_state, key) &&
+      parse_aes_state(cipher_state, cipher)) {
+    std::unique_ptr<WhiteBoxTableGenerator> encryption_table(
+        new WhiteBoxTableGenerator(key_state, true, true,
+                                   TableDirection::ENCRYPTION));
+    std::unique_ptr<WhiteBoxTableGenerator> decryption_table(
+        new WhiteBoxTableGenerator(key_state, true, true,
+                                   TableDirection::DECRYPTION));
+    std::unique_ptr<WhiteBoxData> encryption_data(
+        encryption_table->getEncryptionTable());
+    std::unique_ptr<WhiteBoxData> decryption_data(
+        decryption_table->getDecryptionTable());
+
+    // The other direction is not generated
+    if (encryption_table->getDecryptionTable() != nullptr ||
+        decryption_table->getEncryptionTable() != nullptr)
+      return false;
+
+    return interpret_white_box(*encryption_data, state, false) ==
+               cipher_state &&
+           interpret_white_box(*decryption_data, cipher_state, true) == state;
+  }
+
+  return false;
+}
+
 void run_tests() {
   std::cout << "Running test vectors" << std::endl;
 
@@ -220,6 +1147,437 @@ void run_tests() {
   test_vectors_protected_decryption();
   test_vectors_mixing_decryption();
   test_vectors_protected_mixing_decryption();
+
+  // Multi-block interpreter
+  test_vectors_batch();
+  test_vectors_packed_xor_tables();
+  test_vectors_sse4();
+  test_vectors_avx2();
+  test_vectors_avx512();
+  test_vectors_interpreter_backends();
+
+  // Tables loaded from the binary format
+  test_vectors_binary_table();
+  test_vectors_compact_tables();
+  test_vectors_byte_xor_tables();
+  test_vectors_plain_xor_tables();
+  test_vectors_warm_tables();
+  test_vectors_huge_pages();
+
+  // Multi-threaded modes of operation
+  test_vectors_parallel_ctr();
+  test_vectors_parallel_cbc_decryption();
+  test_vectors_parallel_generation();
+
+  // Keystream computed ahead on a background thread
+  test_vectors_ctr_lookahead();
+  test_vectors_ctr_memoization();
+  test_vectors_ctr_range();
+
+  // Authenticated encryption
+  test_vectors_gcm();
+
+  // Sector-wise encryption
+  test_vectors_xts();
+
+  // Tables of a single direction
+  test_vectors_single_direction_generation();
+}
+
+void test_vectors_parallel_generation() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: multi-threaded table generation" << std::endl;
+  has_succeeded = run_test_vector_parallel_generation(
+      "00112233445566778899aabbccddeeff", "000102030405060708090a0b0c0d0e0f",
+      "69c4e0d86a7b0430d8cdb78070b4c55a");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_single_direction_generation() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: single direction table generation" << std::endl;
+  has_succeeded = run_test_vector_single_direction_generation(
+      "00112233445566778899aabbccddeeff", "000102030405060708090a0b0c0d0e0f",
+      "69c4e0d86a7b0430d8cdb78070b4c55a");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_parallel_cbc_decryption() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: multi-threaded CBC decryption" << std::endl;
+  // NIST SP 800-38A, F.2.2
+  bool has_succeeded = run_test_vectors_parallel_cbc_decryption(
+      "2b7e151628aed2a6abf7158809cf4f3c", "000102030405060708090a0b0c0d0e0f",
+      {"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+       "30c81c46a35ce411e5fbc1191a0a52ef", "f69f2445df4f9b17ad2b417be66c3710"},
+      {"7649abac8119b246cee98e9b12e9197d", "5086cb9b507219ee95db113a917678b2",
+       "73bed6b8e3c1743b7116e69e22229516", "3ff1caa1681fac09120eca307586e1a7"});
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_gcm() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: GCM" << std::endl;
+  // Test cases 2, 3, 4 and 6 of the GCM specification (McGrew and Viega)
+  const std::string plain =
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+      "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255";
+  bool has_succeeded = run_test_vector_gcm(
+      "00000000000000000000000000000000", "000000000000000000000000", "",
+      "00000000000000000000000000000000", "0388dace60b6a392f328c2b971b2fe78",
+      "ab6e47d42cec13bdf53a67b21257bddf");
+  has_succeeded =
+      has_succeeded &&
+      run_test_vector_gcm(
+          "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "",
+          plain,
+          "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+          "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+          "4d5c2af327cd64a62cf35abd2ba6fab4");
+  has_succeeded =
+      has_succeeded &&
+      run_test_vector_gcm(
+          "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+          "feedfacedeadbeeffeedfacedeadbeefabaddad2", plain.substr(0, 120),
+          "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+          "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+          "5bc94fbc3221a5db94fae95ae7121a47");
+  has_succeeded =
+      has_succeeded &&
+      run_test_vector_gcm(
+          "feffe9928665731c6d6a8f9467308308",
+          "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+          "c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b",
+          "feedfacedeadbeeffeedfacedeadbeefabaddad2", plain.substr(0, 120),
+          "8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca7"
+          "01e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+          "619cc5aefffe0bfa462af43c1699d050");
+  has_succeeded = has_succeeded && run_test_vectors_gcm_parallel(
+                                       "feffe9928665731c6d6a8f9467308308");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_xts() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: XTS" << std::endl;
+  // IEEE 1619-2007, vectors 1, 2, 3 and 15 (ciphertext stealing)
+  bool has_succeeded = run_test_vector_xts(
+      "00000000000000000000000000000000", "00000000000000000000000000000000",
+      0,
+      "00000000000000000000000000000000"
+      "00000000000000000000000000000000",
+      "917cf69ebd68b2ec9b9fe9a3eadda692"
+      "cd43d2f59598ed858c02c2652fbf922e");
+  has_succeeded = has_succeeded &&
+                  run_test_vector_xts("11111111111111111111111111111111",
+                                      "22222222222222222222222222222222",
+                                      0x3333333333,
+                                      "44444444444444444444444444444444"
+                                      "44444444444444444444444444444444",
+                                      "c454185e6a16936e39334038acef838b"
+                                      "fb186fff7480adc4289382ecd6d394f0");
+  has_succeeded = has_succeeded &&
+                  run_test_vector_xts("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0",
+                                      "22222222222222222222222222222222",
+                                      0x3333333333,
+                                      "44444444444444444444444444444444"
+                                      "44444444444444444444444444444444",
+                                      "af85336b597afc1a900b2eb21ec949d2"
+                                      "92df4c047e0b21532186a5971a227a89");
+  has_succeeded = has_succeeded &&
+                  run_test_vector_xts("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0",
+                                      "bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0",
+                                      0x123456789a,
+                                      "000102030405060708090a0b0c0d0e0f10",
+                                      "6c1625db4671522d3d7599601de7ca09ed");
+  has_succeeded = has_succeeded &&
+                  run_test_vectors_xts_parallel(
+                      "fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0",
+                      "bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_ctr_range() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: CTR decryption of byte ranges" << std::endl;
+  bool has_succeeded = run_test_vectors_ctr_range(
+      "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_ctr_memoization() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: CTR with memoized first round" << std::endl;
+  bool has_succeeded = run_test_vectors_ctr_memoization(
+      "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfffffef0");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_ctr_lookahead() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: CTR with keystream lookahead" << std::endl;
+  // NIST SP 800-38A, F.5.1
+  bool has_succeeded = run_test_vectors_ctr_lookahead(
+      "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+      {"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+       "30c81c46a35ce411e5fbc1191a0a52ef", "f69f2445df4f9b17ad2b417be66c3710"},
+      {"874d6191b620e3261bef6864990db6ce", "9806f66b7970fdff8617187bb9fffdff",
+       "5ae4df3edbd5d35e5b4f09020db03eab", "1e031dda2fbe03d1792170a0f3009cee"});
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_parallel_ctr() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: multi-threaded CTR" << std::endl;
+  // NIST SP 800-38A, F.5.1; the counter carries into byte 14
+  bool has_succeeded = run_test_vectors_parallel_ctr(
+      "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+      {"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+       "30c81c46a35ce411e5fbc1191a0a52ef", "f69f2445df4f9b17ad2b417be66c3710"},
+      {"874d6191b620e3261bef6864990db6ce", "9806f66b7970fdff8617187bb9fffdff",
+       "5ae4df3edbd5d35e5b4f09020db03eab", "1e031dda2fbe03d1792170a0f3009cee"});
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_binary_table() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: memory-mapped binary table" << std::endl;
+  has_succeeded = run_test_vector_binary_table(
+      "6bc1bee22e409f96e93d7e117393172a", "2b7e151628aed2a6abf7158809cf4f3c",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_compact_tables() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: compact tables without mixing bijections" << std::endl;
+  has_succeeded = run_test_vector_compact_tables(
+      "6bc1bee22e409f96e93d7e117393172a", "2b7e151628aed2a6abf7158809cf4f3c",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_byte_xor_tables() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: byte XOR tables" << std::endl;
+  has_succeeded = run_test_vector_byte_xor_tables(
+      "6bc1bee22e409f96e93d7e117393172a", "2b7e151628aed2a6abf7158809cf4f3c",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_plain_xor_tables() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: plain XOR tables without internal encodings"
+            << std::endl;
+  has_succeeded = run_test_vectors_plain_xor_tables(
+      "2b7e151628aed2a6abf7158809cf4f3c", "6bc1bee22e409f96e93d7e117393172a",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_warm_tables() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: warmed binary table" << std::endl;
+  has_succeeded = run_test_vector_warm_tables(
+      "6bc1bee22e409f96e93d7e117393172a", "2b7e151628aed2a6abf7158809cf4f3c",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_huge_pages() {
+  bool has_succeeded;
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: tables on huge pages" << std::endl;
+  has_succeeded = run_test_vector_huge_pages(
+      "6bc1bee22e409f96e93d7e117393172a", "2b7e151628aed2a6abf7158809cf4f3c",
+      "3ad77bb40d7a3660a89ecaf32466ef97");
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_batch() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: batched full white box" << std::endl;
+  bool has_succeeded = run_test_vectors_batch(
+      "2b7e151628aed2a6abf7158809cf4f3c",
+      {"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+       "30c81c46a35ce411e5fbc1191a0a52ef"},
+      {"3ad77bb40d7a3660a89ecaf32466ef97", "f5d3d58503b9699de785895a96fdbaaf",
+       "43b1cd7f598ece23881b00e3ed030688"},
+      false);
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_sse4() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: SSE4.1 interpreter" << std::endl;
+  if (!cpu_supports_sse4()) {
+    std::cout << "CPU does not support SSE4.1, skipped" << std::endl;
+    return;
+  }
+
+  bool has_succeeded = true;
+  for (bool pack_xor_tables : {false, true}) {
+    if (has_succeeded)
+      has_succeeded = run_test_vectors_batch(
+          "2b7e151628aed2a6abf7158809cf4f3c",
+          {"6bc1bee22e409f96e93d7e117393172a",
+           "ae2d8a571e03ac9c9eb76fac45af8e51",
+           "30c81c46a35ce411e5fbc1191a0a52ef"},
+          {"3ad77bb40d7a3660a89ecaf32466ef97",
+           "f5d3d58503b9699de785895a96fdbaaf",
+           "43b1cd7f598ece23881b00e3ed030688"},
+          pack_xor_tables, interpret_white_box_batch_sse4);
+  }
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_avx2() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: AVX2 interpreter" << std::endl;
+  if (!cpu_supports_avx2()) {
+    std::cout << "CPU does not support AVX2, skipped" << std::endl;
+    return;
+  }
+
+  bool has_succeeded = true;
+  for (bool pack_xor_tables : {false, true}) {
+    if (has_succeeded)
+      has_succeeded = run_test_vectors_batch(
+          "2b7e151628aed2a6abf7158809cf4f3c",
+          {"6bc1bee22e409f96e93d7e117393172a",
+           "ae2d8a571e03ac9c9eb76fac45af8e51",
+           "30c81c46a35ce411e5fbc1191a0a52ef"},
+          {"3ad77bb40d7a3660a89ecaf32466ef97",
+           "f5d3d58503b9699de785895a96fdbaaf",
+           "43b1cd7f598ece23881b00e3ed030688"},
+          pack_xor_tables, interpret_white_box_batch_avx2);
+  }
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_avx512() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: AVX-512 VBMI interpreter" << std::endl;
+  if (!cpu_supports_avx512_vbmi()) {
+    std::cout << "CPU does not support AVX-512 VBMI, skipped" << std::endl;
+    return;
+  }
+
+  bool has_succeeded = true;
+  for (bool pack_xor_tables : {false, true}) {
+    if (has_succeeded)
+      has_succeeded = run_test_vectors_batch(
+          "2b7e151628aed2a6abf7158809cf4f3c",
+          {"6bc1bee22e409f96e93d7e117393172a",
+           "ae2d8a571e03ac9c9eb76fac45af8e51",
+           "30c81c46a35ce411e5fbc1191a0a52ef"},
+          {"3ad77bb40d7a3660a89ecaf32466ef97",
+           "f5d3d58503b9699de785895a96fdbaaf",
+           "43b1cd7f598ece23881b00e3ed030688"},
+          pack_xor_tables, interpret_white_box_batch_avx512);
+  }
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
+
+void test_vectors_packed_xor_tables() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: packed XOR tables" << std::endl;
+  bool has_succeeded = run_test_vectors_batch(
+      "2b7e151628aed2a6abf7158809cf4f3c",
+      {"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+       "30c81c46a35ce411e5fbc1191a0a52ef"},
+      {"3ad77bb40d7a3660a89ecaf32466ef97", "f5d3d58503b9699de785895a96fdbaaf",
+       "43b1cd7f598ece23881b00e3ed030688"},
+      true);
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
 }
 
 void test_vectors_protected_mixing_decryption() {
@@ -395,4 +1753,33 @@ void test_vectors_protected() {
   else
     std::cout << "Test vector failure!" << std::endl;
 }
+void test_vectors_interpreter_backends() {
+  std::cout << "Testing using predefined test vectors" << std::endl;
+  std::cout << "Mode: interpreter backend selection" << std::endl;
+
+  // Every backend this CPU supports runs behind interpret_white_box_batch
+  bool has_succeeded = true;
+  for (const char *name : {"scalar", "sse4", "avx2", "avx512"}) {
+    InterpreterBackend backend;
+    if (!parse_interpreter_backend(backend, name)) has_succeeded = false;
+    if (!has_succeeded || !select_interpreter_backend(backend)) continue;
+
+    has_succeeded = active_interpreter_backend() == backend &&
+                    run_test_vectors_batch(
+                        "2b7e151628aed2a6abf7158809cf4f3c",
+                        {"6bc1bee22e409f96e93d7e117393172a",
+                         "ae2d8a571e03ac9c9eb76fac45af8e51",
+                         "30c81c46a35ce411e5fbc1191a0a52ef"},
+                        {"3ad77bb40d7a3660a89ecaf32466ef97",
+                         "f5d3d58503b9699de785895a96fdbaaf",
+                         "43b1cd7f598ece23881b00e3ed030688"},
+                        true);
+  }
+  select_interpreter_backend(InterpreterBackend::AUTO);
+
+  if (has_succeeded)
+    std::cout << "Test vector success!" << std::endl;
+  else
+    std::cout << "Test vector failure!" << std::endl;
+}
 }  // namespace WhiteBox
@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include <ThreadPool.h>
+
+namespace WhiteBox {
+ThreadPool::ThreadPool(size_t num_threads) {
+  if (num_threads == 0)
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+
+  // The calling thread is the first of the threads
+  for (size_t i = 1; i < num_threads; ++i)
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wakeWorkers_.notify_all();
+  for (auto &worker : workers_) worker.join();
+}
+
+size_t ThreadPool::numThreads() const { return workers_.size() + 1; }
+
+void ThreadPool::parallelFor(size_t num_tasks,
+                             const std::function<void(size_t)> &task) {
+  run(num_tasks, task, false);
+}
+
+void ThreadPool::runOnEachThread(const std::function<void(size_t)> &task) {
+  run(numThreads(), task, true);
+}
+
+void ThreadPool::run(size_t num_tasks, const std::function<void(size_t)> &task,
+                     bool each_thread) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    numTasks_ = num_tasks;
+    eachThread_ = each_thread;
+    nextTask_ = 0;
+    busyWorkers_ = workers_.size();
+    exception_ = nullptr;
+    ++run_;
+  }
+  wakeWorkers_.notify_all();
+
+  runTasks(0);
+
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    workersDone_.wait(lock, [this] { return busyWorkers_ == 0; });
+    task_ = nullptr;
+    exception = exception_;
+  }
+  if (exception) std::rethrow_exception(exception);
+}
+
+void ThreadPool::workerLoop(size_t thread_index) {
+  uint64_t last_run = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wakeWorkers_.wait(lock,
+                        [&] { return stopping_ || run_ != last_run; });
+      if (stopping_) return;
+      last_run = run_;
+    }
+
+    runTasks(thread_index);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busyWorkers_ == 0) workersDone_.notify_one();
+  }
+}
+
+void ThreadPool::runTasks(size_t thread_index) {
+  // task_ and numTasks_ do not change until every worker reported back.
+  // Every worker takes part in every run, so in eachThread_ runs each
+  // thread runs its own index once.
+  for (size_t i = eachThread_ ? thread_index : nextTask_++; i < numTasks_;
+       i = eachThread_ ? numTasks_ : nextTask_++) {
+    try {
+      (*task_)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!exception_) exception_ = std::current_exception();
+    }
+  }
+}
+}  // namespace WhiteBox
@@ -7,7 +7,9 @@
 
 namespace WhiteBox {
 WhiteBoxCipher::WhiteBoxCipher(WhiteBoxData *data, bool encrypt)
-    : encrypt_(encrypt), tables_(data) {}
+    : encrypt_(encrypt),
+      tables_(data),
+      kernel_(select_white_box_kernel(*data, !encrypt)) {}
 
 unsigned int WhiteBoxCipher::BlockSize() const { return AES_BLOCK_SIZE_BYTES; }
 
@@ -25,7 +27,7 @@ void WhiteBoxCipher::ProcessAndXorBlock(const byte *in_block,
   if (xor_block != nullptr)
     std::copy_n(xor_block, AES_BLOCK_SIZE_BYTES, xor_state.begin());
 
-  State output_state = interpret_white_box(*tables_, input_state, !encrypt_);
+  State output_state = kernel_(*tables_, input_state);
 
   if (xor_block != nullptr) {
     State result_state = output_state ^ xor_state;
@@ -36,6 +38,96 @@ void WhiteBoxCipher::ProcessAndXorBlock(const byte *in_block,
   }
 }
 
+size_t WhiteBoxCipher::AdvancedProcessBlocks(const byte *in_blocks,
+                                             const byte *xor_blocks,
+                                             byte *out_blocks, size_t length,
+                                             CryptoPP::word32 flags) const {
+  // Chained calls (e.g. CBC-MAC) depend on the previous block's output,
+  // so only spans the caller marked as parallel are batched
+  if ((flags & BT_AllowParallel) == 0 ||
+      (flags & BT_DontIncrementInOutPointers) != 0) {
+    return BlockTransformation::AdvancedProcessBlocks(in_blocks, xor_blocks,
+                                                      out_blocks, length, flags);
+  }
+
+  const bool in_block_is_counter = (flags & BT_InBlockIsCounter) != 0;
+  const bool xor_input = xor_blocks != nullptr && (flags & BT_XorInput) != 0;
+  const bool xor_output = xor_blocks != nullptr && !xor_input;
+  const bool ctr_keystream = in_block_is_counter && encrypt_ && !xor_input;
+
+  ptrdiff_t in_increment = in_block_is_counter ? 0 : AES_BLOCK_SIZE_BYTES;
+  ptrdiff_t xor_increment = AES_BLOCK_SIZE_BYTES;
+  ptrdiff_t out_increment = AES_BLOCK_SIZE_BYTES;
+
+  if ((flags & BT_ReverseDirection) != 0) {
+    in_blocks += length - AES_BLOCK_SIZE_BYTES;
+    if (xor_blocks != nullptr) xor_blocks += length - AES_BLOCK_SIZE_BYTES;
+    out_blocks += length - AES_BLOCK_SIZE_BYTES;
+    in_increment = -in_increment;
+    xor_increment = -xor_increment;
+    out_increment = -out_increment;
+  }
+
+  std::array<State, INTERPRETER_STAGING_BLOCKS> states;
+
+  while (length >= AES_BLOCK_SIZE_BYTES) {
+    auto blocks = static_cast<ptrdiff_t>(
+        std::min(INTERPRETER_STAGING_BLOCKS, length / AES_BLOCK_SIZE_BYTES));
+
+    // Crypto++ only increments the last counter byte and splits calls
+    // before it wraps; such spans run on the CTR interpreter, which
+    // memoizes round 0 of counters sharing their first bytes
+    byte *counter = const_cast<byte *>(in_blocks);
+    if (ctr_keystream &&
+        counter[AES_BLOCK_SIZE_BYTES - 1] + blocks <= 256) {
+      State iv;
+      std::copy_n(counter, AES_BLOCK_SIZE_BYTES, iv.begin());
+      interpret_white_box_ctr(*tables_, iv, 0, states.data(),
+                              static_cast<size_t>(blocks));
+      counter[AES_BLOCK_SIZE_BYTES - 1] =
+          static_cast<byte>(counter[AES_BLOCK_SIZE_BYTES - 1] + blocks);
+    } else {
+      // All inputs of a batch are read before any output is written, so
+      // in-place and (reversed) CBC decryption work as with single blocks
+      for (ptrdiff_t i = 0; i < blocks; ++i) {
+        std::copy_n(in_blocks + i * in_increment, AES_BLOCK_SIZE_BYTES,
+                    states[i].begin());
+        if (in_block_is_counter) ++counter[AES_BLOCK_SIZE_BYTES - 1];
+        if (xor_input) {
+          const byte *xor_block = xor_blocks + i * xor_increment;
+          for (size_t j = 0; j < AES_BLOCK_SIZE_BYTES; ++j)
+            states[i][j] ^= xor_block[j];
+        }
+      }
+
+      interpret_white_box_batch(*tables_, states.data(), states.data(),
+                                static_cast<size_t>(blocks), !encrypt_);
+    }
+
+    for (ptrdiff_t i = 0; i < blocks; ++i) {
+      byte *out_block = out_blocks + i * out_increment;
+      if (xor_output) {
+        const byte *xor_block = xor_blocks + i * xor_increment;
+        for (size_t j = 0; j < AES_BLOCK_SIZE_BYTES; ++j)
+          out_block[j] = states[i][j] ^ xor_block[j];
+      } else {
+        std::copy_n(states[i].begin(), AES_BLOCK_SIZE_BYTES, out_block);
+      }
+    }
+
+    in_blocks += blocks * in_increment;
+    if (xor_blocks != nullptr) xor_blocks += blocks * xor_increment;
+    out_blocks += blocks * out_increment;
+    length -= static_cast<size_t>(blocks) * AES_BLOCK_SIZE_BYTES;
+  }
+
+  return length;
+}
+
+unsigned int WhiteBoxCipher::OptimalNumberOfBlocksToProcessInParallel() const {
+  return INTERPRETER_STAGING_BLOCKS;
+}
+
 size_t WhiteBoxCipher::GetValidKeyLength(size_t keylength) const {
   return AES_KEY_LENGTH_BYTES;
 }
@@ -2,7 +2,11 @@
 // Created by Christoph Kummer on 26.02.19.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <cryptopp/files.h>
 #include <cryptopp/modes.h>
@@ -29,14 +33,19 @@ namespace WhiteBox {
     }
   }
 
-  void calculate_first_xor_cascade(const WhiteBoxData &tables,
-                                   const IntermediateState &state,
-                                   IntermediateState2 &output_state,
-                                   size_t round,
-                                   bool use_mixing_tables) {
-    const auto &xor_tables =
-      (use_mixing_tables) ? tables.mixingXorTables_ : tables.xorTables_;
+  uint8_t lookup_xor_table(const XorTable &table, uint8_t index) {
+    return table[index];
+  }
+
+  uint8_t lookup_xor_table(const PackedXorTable &table, uint8_t index) {
+    return static_cast<uint8_t>(
+      (table[index >> 1U] >> ((index & 1U) << 2U)) & 0xFU);
+  }
 
+  template <typename Tables>
+  void first_xor_cascade(const Tables &xor_tables,
+                         const IntermediateState &state,
+                         IntermediateState2 &output_state, size_t round) {
     for (size_t i = 0; i < AES_KEY_LENGTH_BYTES; i += 4) {
       uint32_t intermediate_1 = state[i];
       uint32_t intermediate_2 = state[i + 1];
@@ -80,21 +89,21 @@ namespace WhiteBox {
       auto nibble_32 = static_cast<uint8_t>((intermediate_4 & 0xF0000000U) >> 28U);
 
       uint8_t intermediate_nibble_8 =
-        xor_tables[round][i * 4][nibble_8 | nibble_16];
+        lookup_xor_table(xor_tables[round][i * 4], nibble_8 | nibble_16);
       uint8_t intermediate_nibble_7 =
-        xor_tables[round][i * 4 + 1][nibble_7 | nibble_15];
+        lookup_xor_table(xor_tables[round][i * 4 + 1], nibble_7 | nibble_15);
       uint8_t intermediate_nibble_6 =
-        xor_tables[round][i * 4 + 2][nibble_6 | nibble_14];
+        lookup_xor_table(xor_tables[round][i * 4 + 2], nibble_6 | nibble_14);
       uint8_t intermediate_nibble_5 =
-        xor_tables[round][i * 4 + 3][nibble_5 | nibble_13];
+        lookup_xor_table(xor_tables[round][i * 4 + 3], nibble_5 | nibble_13);
       uint8_t intermediate_nibble_4 =
-        xor_tables[round][i * 4 + 4][nibble_4 | nibble_12];
+        lookup_xor_table(xor_tables[round][i * 4 + 4], nibble_4 | nibble_12);
       uint8_t intermediate_nibble_3 =
-        xor_tables[round][i * 4 + 5][nibble_3 | nibble_11];
+        lookup_xor_table(xor_tables[round][i * 4 + 5], nibble_3 | nibble_11);
       uint8_t intermediate_nibble_2 =
-        xor_tables[round][i * 4 + 6][nibble_2 | nibble_10];
+        lookup_xor_table(xor_tables[round][i * 4 + 6], nibble_2 | nibble_10);
       uint8_t intermediate_nibble_1 =
-        xor_tables[round][i * 4 + 7][nibble_1 | nibble_9];
+        lookup_xor_table(xor_tables[round][i * 4 + 7], nibble_1 | nibble_9);
 
       uint32_t res_1 =
         (intermediate_nibble_8 << 28U) | (intermediate_nibble_7 << 24U) |
@@ -103,21 +112,21 @@ namespace WhiteBox {
         (intermediate_nibble_2 << 4U) | intermediate_nibble_1;
 
       uint8_t intermediate_nibble_16 =
-        xor_tables[round][i * 4 + 8][nibble_24 | nibble_32];
+        lookup_xor_table(xor_tables[round][i * 4 + 8], nibble_24 | nibble_32);
       uint8_t intermediate_nibble_15 =
-        xor_tables[round][i * 4 + 9][nibble_23 | nibble_31];
+        lookup_xor_table(xor_tables[round][i * 4 + 9], nibble_23 | nibble_31);
       uint8_t intermediate_nibble_14 =
-        xor_tables[round][i * 4 + 10][nibble_22 | nibble_30];
+        lookup_xor_table(xor_tables[round][i * 4 + 10], nibble_22 | nibble_30);
       uint8_t intermediate_nibble_13 =
-        xor_tables[round][i * 4 + 11][nibble_21 | nibble_29];
+        lookup_xor_table(xor_tables[round][i * 4 + 11], nibble_21 | nibble_29);
       uint8_t intermediate_nibble_12 =
-        xor_tables[round][i * 4 + 12][nibble_20 | nibble_28];
+        lookup_xor_table(xor_tables[round][i * 4 + 12], nibble_20 | nibble_28);
       uint8_t intermediate_nibble_11 =
-        xor_tables[round][i * 4 + 13][nibble_19 | nibble_27];
+        lookup_xor_table(xor_tables[round][i * 4 + 13], nibble_19 | nibble_27);
       uint8_t intermediate_nibble_10 =
-        xor_tables[round][i * 4 + 14][nibble_18 | nibble_26];
+        lookup_xor_table(xor_tables[round][i * 4 + 14], nibble_18 | nibble_26);
       uint8_t intermediate_nibble_9 =
-        xor_tables[round][i * 4 + 15][nibble_17 | nibble_25];
+        lookup_xor_table(xor_tables[round][i * 4 + 15], nibble_17 | nibble_25);
 
       uint32_t res_2 =
         (intermediate_nibble_16 << 28U) | (intermediate_nibble_15 << 24U) |
@@ -130,13 +139,10 @@ namespace WhiteBox {
     }
   }
 
-  void calculate_second_xor_cascade(const WhiteBoxData &tables,
-                                    const IntermediateState2 &state,
-                                    State &output_state, size_t round,
-                                    bool use_mixing_tables) {
-    const auto &xor_tables =
-      (use_mixing_tables) ? tables.mixingXorTables_ : tables.xorTables_;
-
+  template <typename Tables>
+  void second_xor_cascade(const Tables &xor_tables,
+                          const IntermediateState2 &state,
+                          State &output_state, size_t round) {
     for (size_t i = 0; i < AES_KEY_LENGTH_BYTES / 2; i += 2) {
       uint32_t left = state[i];
       uint32_t right = state[i + 1];
@@ -160,21 +166,21 @@ namespace WhiteBox {
       auto nibble_16 = static_cast<uint8_t>((right & 0xF0000000U) >> 28U);
 
       uint8_t final_nibble_8 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET][nibble_8 | nibble_16];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET], nibble_8 | nibble_16);
       uint8_t final_nibble_7 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 1][nibble_7 | nibble_15];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 1], nibble_7 | nibble_15);
       uint8_t final_nibble_6 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 2][nibble_6 | nibble_14];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 2], nibble_6 | nibble_14);
       uint8_t final_nibble_5 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 3][nibble_5 | nibble_13];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 3], nibble_5 | nibble_13);
       uint8_t final_nibble_4 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 4][nibble_4 | nibble_12];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 4], nibble_4 | nibble_12);
       uint8_t final_nibble_3 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 5][nibble_3 | nibble_11];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 5], nibble_3 | nibble_11);
       uint8_t final_nibble_2 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 6][nibble_2 | nibble_10];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 6], nibble_2 | nibble_10);
       uint8_t final_nibble_1 =
-        xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 7][nibble_1 | nibble_9];
+        lookup_xor_table(xor_tables[round][i * 4 + XOR_TABLE_OFFSET + 7], nibble_1 | nibble_9);
 
       output_state[2 * i] = static_cast<uint8_t>((final_nibble_8 << 4U)) | final_nibble_7;
       output_state[2 * i + 1] = static_cast<uint8_t>((final_nibble_6 << 4U)) | final_nibble_5;
@@ -183,87 +189,672 @@ namespace WhiteBox {
     }
   }
 
+  void calculate_first_xor_cascade(const WhiteBoxData &tables,
+                                   const IntermediateState &state,
+                                   IntermediateState2 &output_state,
+                                   size_t round,
+                                   bool use_mixing_tables) {
+    if (tables.usesPackedXorTables_) {
+      const auto &xor_tables = (use_mixing_tables)
+        ? tables.packedMixingXorTables_ : tables.packedXorTables_;
+      first_xor_cascade(xor_tables, state, output_state, round);
+    } else {
+      const auto &xor_tables =
+        (use_mixing_tables) ? tables.mixingXorTables_ : tables.xorTables_;
+      first_xor_cascade(xor_tables, state, output_state, round);
+    }
+  }
+
+  void calculate_second_xor_cascade(const WhiteBoxData &tables,
+                                    const IntermediateState2 &state,
+                                    State &output_state, size_t round,
+                                    bool use_mixing_tables) {
+    if (tables.usesPackedXorTables_) {
+      const auto &xor_tables = (use_mixing_tables)
+        ? tables.packedMixingXorTables_ : tables.packedXorTables_;
+      second_xor_cascade(xor_tables, state, output_state, round);
+    } else {
+      const auto &xor_tables =
+        (use_mixing_tables) ? tables.mixingXorTables_ : tables.xorTables_;
+      second_xor_cascade(xor_tables, state, output_state, round);
+    }
+  }
+
   void apply_final_round_t_boxes(const WhiteBoxData &tables, const State& state, State& output_state) {
     for (size_t i = 0; i < AES_KEY_LENGTH_BYTES; ++i) {
       output_state[i] = tables.finalRoundTBoxes_[i][state[i]];
     }
   }
 
-  State interpret_white_box_no_mixing(
-    const WhiteBoxData &white_box_encryption_data, const State &state, bool decrypt) {
-    State finalResult = state;
-    State shifted_state;
-    IntermediateState intermediateState;
-    IntermediateState2 intermediateState2;
+  // XORs two encoded words nibble by nibble; nibble k (counting from the
+  // least significant one) is looked up in tables[7 - k], matching the
+  // table order used by the XOR cascades
+  template <typename Table>
+  uint32_t xor_encoded_words(const Table *tables, uint32_t left,
+                             uint32_t right) {
+    uint32_t result = 0;
+    for (uint32_t k = 0; k < 8; ++k) {
+      auto index = static_cast<uint8_t>((((left >> (4U * k)) & 0xFU) << 4U) |
+                                        ((right >> (4U * k)) & 0xFU));
+      result |= static_cast<uint32_t>(lookup_xor_table(tables[7 - k], index))
+        << (4U * k);
+    }
+    return result;
+  }
 
-    for (size_t i = 0; i < 9; ++i) {
-      if (!decrypt)
-        shift_rows_in_place(finalResult, shifted_state);
-      else
-        inverse_shift_rows_in_place(finalResult, shifted_state);
-       calculate_intermediate_tyi_box_results(
-        white_box_encryption_data, shifted_state, intermediateState, i);
-      calculate_first_xor_cascade(
-        white_box_encryption_data, intermediateState, intermediateState2, i, false);
-      calculate_second_xor_cascade(white_box_encryption_data,
-                                   intermediateState2, finalResult, i, false);
+  // The first XOR cascade of a column, in halves: half 0 XORs the words of
+  // rows 0 and 1, half 1 those of rows 2 and 3
+  template <typename Tables>
+  uint32_t xor_cascade_half(const Tables &xor_tables, size_t column,
+                            size_t half, uint32_t word_1, uint32_t word_2) {
+    return xor_encoded_words(&xor_tables[column * 16 + half * 8], word_1,
+                             word_2);
+  }
+
+  // The second XOR cascade, combining both halves into the column
+  template <typename Tables>
+  uint32_t xor_cascade_combine(const Tables &xor_tables, size_t column,
+                               uint32_t left, uint32_t right) {
+    return xor_encoded_words(&xor_tables[XOR_TABLE_OFFSET + column * 8], left,
+                             right);
+  }
+
+  // xor_encoded_words on byte XOR tables: byte k is looked up in
+  // tables[3 - k], which combines the nibble tables of its two nibbles
+  uint32_t xor_encoded_words(const ByteXorTable *tables, uint32_t left,
+                             uint32_t right) {
+    uint32_t result = 0;
+    for (uint32_t k = 0; k < 4; ++k) {
+      uint32_t index = (((left >> (8U * k)) & 0xFFU) << 8U) |
+                       ((right >> (8U * k)) & 0xFFU);
+      result |= static_cast<uint32_t>(tables[3 - k][index]) << (8U * k);
     }
+    return result;
+  }
 
-    if (!decrypt)
-      shift_rows_in_place(finalResult, shifted_state);
-    else
-      inverse_shift_rows_in_place(finalResult, shifted_state);
+  uint32_t xor_cascade_half(const RoundByteXorTables &xor_tables,
+                            size_t column, size_t half, uint32_t word_1,
+                            uint32_t word_2) {
+    return xor_encoded_words(&xor_tables[column * 8 + half * 4], word_1,
+                             word_2);
+  }
 
-    apply_final_round_t_boxes(white_box_encryption_data, shifted_state, finalResult);
+  uint32_t xor_cascade_combine(const RoundByteXorTables &xor_tables,
+                               size_t column, uint32_t left, uint32_t right) {
+    return xor_encoded_words(&xor_tables[BYTE_XOR_TABLE_OFFSET + column * 4],
+                             left, right);
+  }
 
-    return finalResult;
+  // Plain XOR tables XOR nibble by nibble, so the cascades XOR the words
+  uint32_t xor_cascade_half(PlainXorTables, size_t, size_t, uint32_t word_1,
+                            uint32_t word_2) {
+    return word_1 ^ word_2;
   }
 
-  State interpret_white_box_mixing(const WhiteBoxData &white_box_encryption_data,
-                                   const State &state, bool decrypt) {
-    State finalResult = state;
-    State shifted_state;
-    IntermediateState intermediateState;
-    IntermediateState2 intermediateState2;
+  uint32_t xor_cascade_combine(PlainXorTables, size_t, uint32_t left,
+                               uint32_t right) {
+    return left ^ right;
+  }
 
-    for (size_t i = 0; i < 9; ++i) {
-      if (!decrypt)
-        shift_rows_in_place(finalResult, shifted_state);
-      else
-        inverse_shift_rows_in_place(finalResult, shifted_state);
-
-      calculate_intermediate_tyi_box_results(
-        white_box_encryption_data, shifted_state, intermediateState, i);
-      calculate_first_xor_cascade(
-        white_box_encryption_data, intermediateState, intermediateState2, i, false);
-      calculate_second_xor_cascade(white_box_encryption_data,
-                                   intermediateState2, finalResult, i, false);
-      calculate_mixing_table_results(
-        white_box_encryption_data, finalResult, intermediateState, i);
-      calculate_first_xor_cascade(
-        white_box_encryption_data, intermediateState, intermediateState2, i, true);
-      calculate_second_xor_cascade(white_box_encryption_data,
-                                   intermediateState2, finalResult, i, true);
+  // Both XOR cascades for one column: 4 encoded words in, 4 bytes out,
+  // packed big-endian into a single word
+  template <typename Tables>
+  uint32_t xor_cascades_column(const Tables &xor_tables, size_t column,
+                               uint32_t word_1, uint32_t word_2,
+                               uint32_t word_3, uint32_t word_4) {
+    return xor_cascade_combine(
+      xor_tables, column,
+      xor_cascade_half(xor_tables, column, 0, word_1, word_2),
+      xor_cascade_half(xor_tables, column, 1, word_3, word_4));
+  }
+
+  // The end of a round for one column: the mixing step, if compiled in,
+  // then the column's bytes are written to output_state
+  template <bool Mixing, typename Tables>
+  inline void store_round_column(const WhiteBoxData &data,
+                                 const Tables &mixing_xor_tables,
+                                 uint32_t column, size_t c,
+                                 State &output_state, size_t round) {
+    const size_t i = c * 4;
+    if constexpr (Mixing) {
+      const auto &mixing_tables = data.mixingTables_[round];
+      column = xor_cascades_column(
+        mixing_xor_tables[round], c,
+        mixing_tables[i][column >> 24U],
+        mixing_tables[i + 1][(column >> 16U) & 0xFFU],
+        mixing_tables[i + 2][(column >> 8U) & 0xFFU],
+        mixing_tables[i + 3][column & 0xFFU]);
     }
 
-    if (!decrypt)
-      shift_rows_in_place(finalResult, shifted_state);
-    else
-      inverse_shift_rows_in_place(finalResult, shifted_state);
-    apply_final_round_t_boxes(white_box_encryption_data, shifted_state, finalResult);
+    output_state[i] = static_cast<uint8_t>(column >> 24U);
+    output_state[i + 1] = static_cast<uint8_t>(column >> 16U);
+    output_state[i + 2] = static_cast<uint8_t>(column >> 8U);
+    output_state[i + 3] = static_cast<uint8_t>(column);
+  }
+
+  // One of the first nine rounds, column by column: each output column
+  // only depends on the four bytes shift-rows moves into it, so tyi
+  // lookups, both cascades and the mixing step run on values held in
+  // locals, without storing the intermediate states in between
+  template <InterpreterDirection Direction, bool Mixing, typename Tables>
+  inline void interpret_round_fused(const WhiteBoxData &data,
+                                    const Tables &xor_tables,
+                                    const Tables &mixing_xor_tables,
+                                    const State &state, State &output_state,
+                                    size_t round) {
+    constexpr const auto &shift = shift_rows_indices<Direction>();
+    const auto &tyi_tables = data.tyiTables_[round];
+
+    for (size_t c = 0; c < 4; ++c) {
+      const size_t i = c * 4;
+      uint32_t column = xor_cascades_column(
+        xor_tables[round], c,
+        tyi_tables[i][state[shift[i]]], tyi_tables[i + 1][state[shift[i + 1]]],
+        tyi_tables[i + 2][state[shift[i + 2]]],
+        tyi_tables[i + 3][state[shift[i + 3]]]);
+
+      store_round_column<Mixing>(data, mixing_xor_tables, column, c,
+                                 output_state, round);
+    }
+  }
+
+  // Final round with shift-rows folded into the T-box indexing;
+  // output_state must not alias state
+  template <InterpreterDirection Direction>
+  inline void interpret_final_round_fused(const WhiteBoxData &data,
+                                          const State &state,
+                                          State &output_state) {
+    constexpr const auto &shift = shift_rows_indices<Direction>();
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i) {
+      output_state[i] = data.finalRoundTBoxes_[i][state[shift[i]]];
+    }
+  }
+
+  // The nine rounds are expanded by the fold over Rounds, ping-ponging
+  // between two states, so every round index is a compile-time constant
+  template <InterpreterDirection Direction, bool Mixing, typename Tables,
+            size_t... Rounds>
+  inline State interpret_rounds_unrolled(const WhiteBoxData &data,
+                                         const Tables &xor_tables,
+                                         const Tables &mixing_xor_tables,
+                                         const State &input_state,
+                                         std::index_sequence<Rounds...>) {
+    std::array<State, 2> states;
+    states[0] = input_state;
+    (interpret_round_fused<Direction, Mixing>(
+       data, xor_tables, mixing_xor_tables, states[Rounds % 2],
+       states[(Rounds + 1) % 2], Rounds), ...);
+
+    State output_state;
+    interpret_final_round_fused<Direction>(
+      data, states[sizeof...(Rounds) % 2], output_state);
+    return output_state;
+  }
+
+  // Without mixing bijections there are no byte mixing XOR tables, and the
+  // interpreter never reads the ones it is passed
+  template <bool Mixing>
+  const ByteXorTables &byte_mixing_xor_tables(const WhiteBoxData &data) {
+    return (Mixing) ? data.byteMixingXorTables_ : data.byteXorTables_;
+  }
+
+  template <InterpreterDirection Direction, bool Mixing>
+  State interpret_white_box(const WhiteBoxData &white_box_encryption_data,
+                            const State &input_state) {
+    const WhiteBoxData &data = white_box_encryption_data;
+    if (data.usesPlainXorTables_)
+      return interpret_rounds_unrolled<Direction, Mixing>(
+        data, PlainXorTables(), PlainXorTables(), input_state,
+        std::make_index_sequence<9>());
+    if (data.xorGranularity_ == TableGranularity::BYTE)
+      return interpret_rounds_unrolled<Direction, Mixing>(
+        data, data.byteXorTables_, byte_mixing_xor_tables<Mixing>(data),
+        input_state, std::make_index_sequence<9>());
+    if (data.usesPackedXorTables_)
+      return interpret_rounds_unrolled<Direction, Mixing>(
+        data, data.packedXorTables_, data.packedMixingXorTables_, input_state,
+        std::make_index_sequence<9>());
+    return interpret_rounds_unrolled<Direction, Mixing>(
+      data, data.xorTables_, data.mixingXorTables_, input_state,
+      std::make_index_sequence<9>());
+  }
 
-    return finalResult;
+  template State
+  interpret_white_box<InterpreterDirection::ENCRYPT, false>(
+    const WhiteBoxData &, const State &);
+  template State
+  interpret_white_box<InterpreterDirection::ENCRYPT, true>(
+    const WhiteBoxData &, const State &);
+  template State
+  interpret_white_box<InterpreterDirection::DECRYPT, false>(
+    const WhiteBoxData &, const State &);
+  template State
+  interpret_white_box<InterpreterDirection::DECRYPT, true>(
+    const WhiteBoxData &, const State &);
+
+  WhiteBoxKernel select_white_box_kernel(
+    const WhiteBoxData &white_box_encryption_data, bool decrypt) {
+    const bool mixing = white_box_encryption_data.usesMixingBijections_;
+    if (decrypt)
+      return (mixing)
+        ? interpret_white_box<InterpreterDirection::DECRYPT, true>
+        : interpret_white_box<InterpreterDirection::DECRYPT, false>;
+    return (mixing)
+      ? interpret_white_box<InterpreterDirection::ENCRYPT, true>
+      : interpret_white_box<InterpreterDirection::ENCRYPT, false>;
   }
 
   State interpret_white_box(const WhiteBoxData &white_box_encryption_data,
                             const State &input_state, bool decrypt) {
-    if (!white_box_encryption_data.usesMixingBijections_) {
-      return interpret_white_box_no_mixing(white_box_encryption_data, input_state,
-                                           decrypt);
-    } else {
-      return interpret_white_box_mixing(white_box_encryption_data, input_state,
-                                        decrypt);
+    return select_white_box_kernel(white_box_encryption_data, decrypt)(
+      white_box_encryption_data, input_state);
+  }
+
+  // One round for all lanes
+  template <InterpreterDirection Direction, bool Mixing, typename Tables>
+  inline void interpret_round_lanes(const WhiteBoxData &data,
+                                    const Tables &xor_tables,
+                                    const Tables &mixing_xor_tables,
+                                    const State *states, State *output_states,
+                                    size_t lanes, size_t round) {
+    for (size_t l = 0; l < lanes; ++l) {
+      interpret_round_fused<Direction, Mixing>(
+        data, xor_tables, mixing_xor_tables, states[l], output_states[l],
+        round);
+    }
+  }
+
+  // Every round is done for all lanes before moving on to the next one;
+  // the lanes do not depend on each other, so their lookups can overlap.
+  // Rounds before first_round are skipped; the input is placed where the
+  // round before would have left it.
+  template <InterpreterDirection Direction, bool Mixing, typename Tables,
+            size_t... Rounds>
+  inline void interpret_interleaved_unrolled(
+    const WhiteBoxData &data, const Tables &xor_tables,
+    const Tables &mixing_xor_tables, const State *input_states,
+    State *output_states, size_t lanes, size_t first_round,
+    std::index_sequence<Rounds...>) {
+    std::array<std::array<State, INTERPRETER_BATCH_SIZE>, 2> states;
+    std::copy_n(input_states, lanes, states[first_round % 2].begin());
+
+    ((Rounds >= first_round
+        ? interpret_round_lanes<Direction, Mixing>(
+            data, xor_tables, mixing_xor_tables, states[Rounds % 2].data(),
+            states[(Rounds + 1) % 2].data(), lanes, Rounds)
+        : void()), ...);
+
+    for (size_t l = 0; l < lanes; ++l) {
+      interpret_final_round_fused<Direction>(
+        data, states[sizeof...(Rounds) % 2][l], output_states[l]);
+    }
+  }
+
+  template <InterpreterDirection Direction, bool Mixing>
+  void interpret_white_box_interleaved(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, size_t first_round) {
+    const WhiteBoxData &data = white_box_encryption_data;
+    for (size_t i = 0; i < n; i += INTERPRETER_BATCH_SIZE) {
+      size_t lanes = std::min(INTERPRETER_BATCH_SIZE, n - i);
+      if (data.usesPlainXorTables_)
+        interpret_interleaved_unrolled<Direction, Mixing>(
+          data, PlainXorTables(), PlainXorTables(), input_states + i,
+          output_states + i, lanes, first_round,
+          std::make_index_sequence<9>());
+      else if (data.xorGranularity_ == TableGranularity::BYTE)
+        interpret_interleaved_unrolled<Direction, Mixing>(
+          data, data.byteXorTables_, byte_mixing_xor_tables<Mixing>(data),
+          input_states + i, output_states + i, lanes, first_round,
+          std::make_index_sequence<9>());
+      else if (data.usesPackedXorTables_)
+        interpret_interleaved_unrolled<Direction, Mixing>(
+          data, data.packedXorTables_, data.packedMixingXorTables_,
+          input_states + i, output_states + i, lanes, first_round,
+          std::make_index_sequence<9>());
+      else
+        interpret_interleaved_unrolled<Direction, Mixing>(
+          data, data.xorTables_, data.mixingXorTables_, input_states + i,
+          output_states + i, lanes, first_round,
+          std::make_index_sequence<9>());
+    }
+  }
+
+  void interpret_white_box_batch_scalar(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+    const bool mixing = white_box_encryption_data.usesMixingBijections_;
+    if (decrypt && mixing)
+      interpret_white_box_interleaved<InterpreterDirection::DECRYPT, true>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+    else if (decrypt)
+      interpret_white_box_interleaved<InterpreterDirection::DECRYPT, false>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+    else if (mixing)
+      interpret_white_box_interleaved<InterpreterDirection::ENCRYPT, true>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+    else
+      interpret_white_box_interleaved<InterpreterDirection::ENCRYPT, false>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+  }
+
+  namespace {
+  typedef void (*BatchInterpreter)(const WhiteBoxData &, const State *,
+                                   State *, size_t, bool, size_t);
+
+  struct InterpreterBackendEntry {
+    InterpreterBackend backend_;
+    const char *name_;
+    bool (*cpuSupports_)();
+    BatchInterpreter interpret_;
+    // Blocks the backend needs to be worth running; fewer remaining
+    // blocks are left to the next enabled backend
+    size_t minBlocks_;
+  };
+
+  bool cpu_supports_scalar() { return true; }
+
+  // Fastest first; the scalar interpreter is always last
+  const std::array<InterpreterBackendEntry, 4> INTERPRETER_BACKENDS = {{
+    {InterpreterBackend::AVX512, "avx512", cpu_supports_avx512_vbmi,
+     interpret_white_box_batch_avx512, AVX512_BATCH_SIZE},
+    {InterpreterBackend::AVX2, "avx2", cpu_supports_avx2,
+     interpret_white_box_batch_avx2, 1},
+    {InterpreterBackend::SSE4, "sse4", cpu_supports_sse4,
+     interpret_white_box_batch_sse4, 1},
+    {InterpreterBackend::SCALAR, "scalar", cpu_supports_scalar,
+     interpret_white_box_batch_scalar, 1},
+  }};
+
+  struct InterpreterBackendSelection {
+    // Backends that passed the CPU check and the self-check
+    std::array<bool, INTERPRETER_BACKENDS.size()> enabled_{};
+    bool checked_ = false;
+    // Index of the backend batches start on
+    size_t first_ = INTERPRETER_BACKENDS.size() - 1;
+  };
+
+  // Known answer and tables of the self-check, generated once for all
+  // backends
+  struct SelfCheckData {
+    std::unique_ptr<WhiteBoxData> encryption_;
+    std::unique_ptr<WhiteBoxData> decryption_;
+    std::vector<State> input_;
+    State cipher_;
+  };
+
+  // Tables for the FIPS-197 test key, without encodings as those only
+  // change table contents, not the code path
+  SelfCheckData make_self_check_data() {
+    State key;
+    State plain;
+    SelfCheckData data;
+    parse_aes_state(key, "2b7e151628aed2a6abf7158809cf4f3c");
+    parse_aes_state(plain, "6bc1bee22e409f96e93d7e117393172a");
+    parse_aes_state(data.cipher_, "3ad77bb40d7a3660a89ecaf32466ef97");
+
+    WhiteBoxTableGenerator generator(key, false, true);
+    data.encryption_.reset(generator.getEncryptionTable());
+    data.decryption_.reset(generator.getDecryptionTable());
+
+    // A full batch of the widest backend and a partial one
+    data.input_.resize(AVX512_BATCH_SIZE + 3);
+    for (size_t i = 0; i < data.input_.size(); ++i) {
+      data.input_[i] = plain;
+      data.input_[i][0] = static_cast<uint8_t>(data.input_[i][0] ^ i);
+    }
+    return data;
+  }
+
+  // Runs the backend on the self-check tables in both directions and
+  // compares every block with the scalar interpreter and the expected
+  // ciphertext
+  bool self_check_backend(const InterpreterBackendEntry &entry,
+                          const SelfCheckData &data) {
+    const size_t num_blocks = data.input_.size();
+    std::vector<State> output(num_blocks);
+    entry.interpret_(*data.encryption_, data.input_.data(), output.data(),
+                     num_blocks, false, 0);
+    if (output[0] != data.cipher_) return false;
+    for (size_t i = 0; i < num_blocks; ++i) {
+      if (output[i] !=
+          interpret_white_box(*data.encryption_, data.input_[i], false))
+        return false;
+    }
+
+    entry.interpret_(*data.decryption_, output.data(), output.data(),
+                     num_blocks, true, 0);
+    for (size_t i = 0; i < num_blocks; ++i) {
+      if (output[i] != data.input_[i]) return false;
+    }
+    return true;
+  }
+
+  void check_backends(InterpreterBackendSelection &selection) {
+    if (selection.checked_) return;
+    // The scalar interpreter is the reference the others are checked with
+    bool any_simd = false;
+    for (size_t i = 0; i < INTERPRETER_BACKENDS.size(); ++i) {
+      const auto &entry = INTERPRETER_BACKENDS[i];
+      selection.enabled_[i] = entry.backend_ == InterpreterBackend::SCALAR ||
+                              entry.cpuSupports_();
+      any_simd = any_simd || (entry.backend_ != InterpreterBackend::SCALAR &&
+                              selection.enabled_[i]);
+    }
+    selection.checked_ = true;
+    if (!any_simd) return;
+
+    // The tables are generated without internal encodings, so their XOR
+    // tables are plain; the table lookups are checked with that cleared,
+    // then on packed XOR tables. Every backend runs on every layout.
+    SelfCheckData data = make_self_check_data();
+    for (int layout = 0; layout < 3; ++layout) {
+      if (layout == 1) {
+        data.encryption_->usesPlainXorTables_ = false;
+        data.decryption_->usesPlainXorTables_ = false;
+      } else if (layout == 2) {
+        data.encryption_->packXorTables();
+        data.decryption_->packXorTables();
+      }
+      for (size_t i = 0; i < INTERPRETER_BACKENDS.size(); ++i) {
+        const auto &entry = INTERPRETER_BACKENDS[i];
+        if (entry.backend_ != InterpreterBackend::SCALAR &&
+            selection.enabled_[i])
+          selection.enabled_[i] = self_check_backend(entry, data);
+      }
+    }
+  }
+
+  InterpreterBackendSelection &backend_selection() {
+    static InterpreterBackendSelection selection;
+    return selection;
+  }
+
+  // Selects AUTO on first use unless a backend was chosen explicitly
+  InterpreterBackendSelection &initialized_backend_selection() {
+    static bool initialized = backend_selection().checked_ ||
+      select_interpreter_backend(InterpreterBackend::AUTO);
+    (void) initialized;
+    return backend_selection();
+  }
+  }  // namespace
+
+  bool parse_interpreter_backend(InterpreterBackend &backend,
+                                 const std::string &name) {
+    if (name == "auto") {
+      backend = InterpreterBackend::AUTO;
+      return true;
+    }
+    for (const auto &entry : INTERPRETER_BACKENDS) {
+      if (name == entry.name_) {
+        backend = entry.backend_;
+        return true;
+      }
     }
+    return false;
+  }
+
+  const char *interpreter_backend_name(InterpreterBackend backend) {
+    for (const auto &entry : INTERPRETER_BACKENDS) {
+      if (entry.backend_ == backend) return entry.name_;
+    }
+    return "auto";
+  }
+
+  bool select_interpreter_backend(InterpreterBackend backend) {
+    InterpreterBackendSelection &selection = backend_selection();
+    check_backends(selection);
+    for (size_t i = 0; i < INTERPRETER_BACKENDS.size(); ++i) {
+      if (selection.enabled_[i] &&
+          (backend == InterpreterBackend::AUTO ||
+           backend == INTERPRETER_BACKENDS[i].backend_)) {
+        selection.first_ = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  InterpreterBackend active_interpreter_backend() {
+    return INTERPRETER_BACKENDS[initialized_backend_selection().first_]
+      .backend_;
+  }
+
+  void interpret_white_box_batch(const WhiteBoxData &white_box_encryption_data,
+                                 const State *input_states,
+                                 State *output_states, size_t n,
+                                 bool decrypt, size_t first_round) {
+    // The SIMD backends are written for nibble XOR tables
+    if (white_box_encryption_data.xorGranularity_ == TableGranularity::BYTE &&
+        !white_box_encryption_data.usesPlainXorTables_) {
+      interpret_white_box_batch_scalar(white_box_encryption_data, input_states,
+                                       output_states, n, decrypt, first_round);
+      return;
+    }
+    const InterpreterBackendSelection &selection =
+      initialized_backend_selection();
+    for (size_t i = selection.first_; n > 0; ++i) {
+      const auto &entry = INTERPRETER_BACKENDS[i];
+      if (!selection.enabled_[i] || n < entry.minBlocks_) continue;
+      size_t blocks = n - n % entry.minBlocks_;
+      entry.interpret_(white_box_encryption_data, input_states, output_states,
+                       blocks, decrypt, first_round);
+      input_states += blocks;
+      output_states += blocks;
+      n -= blocks;
+    }
+  }
+
+  namespace {
+  // Position the last counter byte is moved to by shift-rows; among
+  // counters that only differ in that byte, the round-0 Tyi lookup at this
+  // position is the only one whose input changes
+  constexpr size_t ctr_low_byte_position() {
+    constexpr const auto &shift =
+      shift_rows_indices<InterpreterDirection::ENCRYPT>();
+    size_t i = 0;
+    while (shift[i] != AES_BLOCK_SIZE_BYTES - 1) ++i;
+    return i;
+  }
+
+  constexpr size_t CTR_LOW_BYTE_POSITION = ctr_low_byte_position();
+  constexpr size_t CTR_LOW_COLUMN = CTR_LOW_BYTE_POSITION / 4;
+  constexpr size_t CTR_LOW_ROW = CTR_LOW_BYTE_POSITION % 4;
+
+  // Round 0 of consecutive counter blocks. Round-0 results that only depend
+  // on the first 15 counter bytes are kept while those bytes stay the same:
+  // the three other output columns, the cascade half without the last byte
+  // and the Tyi word paired with it. Per block, one Tyi lookup, the
+  // remaining cascade half, the second cascade and the mixing step of a
+  // single column are left. A carry out of the last byte changes the prefix
+  // and rebuilds the cache from a full round.
+  template <bool Mixing, typename Tables>
+  void interpret_ctr_first_round(const WhiteBoxData &data,
+                                 const Tables &xor_tables,
+                                 const Tables &mixing_xor_tables,
+                                 State counter, State *output_states,
+                                 size_t n) {
+    constexpr const auto &shift =
+      shift_rows_indices<InterpreterDirection::ENCRYPT>();
+    constexpr size_t c = CTR_LOW_COLUMN;
+    constexpr size_t half = CTR_LOW_ROW / 2;
+    const auto &tyi_tables = data.tyiTables_[0];
+
+    State prefix;
+    State round_state;
+    uint32_t paired_word = 0;
+    uint32_t other_half = 0;
+
+    for (size_t b = 0; b < n; ++b) {
+      if (b == 0 || !std::equal(prefix.begin(), prefix.end() - 1,
+                                counter.begin())) {
+        interpret_round_fused<InterpreterDirection::ENCRYPT, Mixing>(
+          data, xor_tables, mixing_xor_tables, counter, round_state, 0);
+        auto tyi_word = [&](size_t row) {
+          return tyi_tables[c * 4 + row][counter[shift[c * 4 + row]]];
+        };
+        prefix = counter;
+        paired_word = tyi_word(CTR_LOW_ROW ^ 1U);
+        other_half = xor_cascade_half(xor_tables[0], c, 1 - half,
+                                      tyi_word(2 - 2 * half),
+                                      tyi_word(3 - 2 * half));
+      } else {
+        uint32_t low_word = tyi_tables[CTR_LOW_BYTE_POSITION]
+                                      [counter[AES_BLOCK_SIZE_BYTES - 1]];
+        uint32_t low_half =
+          (CTR_LOW_ROW % 2 == 0)
+            ? xor_cascade_half(xor_tables[0], c, half, low_word, paired_word)
+            : xor_cascade_half(xor_tables[0], c, half, paired_word, low_word);
+        uint32_t column =
+          (half == 0)
+            ? xor_cascade_combine(xor_tables[0], c, low_half, other_half)
+            : xor_cascade_combine(xor_tables[0], c, other_half, low_half);
+        store_round_column<Mixing>(data, mixing_xor_tables, column, c,
+                                   round_state, 0);
+      }
+      output_states[b] = round_state;
+      counter = add_to_counter(counter, 1);
+    }
+  }
+
+  template <bool Mixing>
+  void interpret_ctr_first_round(const WhiteBoxData &data,
+                                 const State &counter, State *output_states,
+                                 size_t n) {
+    if (data.usesPlainXorTables_)
+      interpret_ctr_first_round<Mixing>(data, PlainXorTables(),
+                                        PlainXorTables(), counter,
+                                        output_states, n);
+    else if (data.xorGranularity_ == TableGranularity::BYTE)
+      interpret_ctr_first_round<Mixing>(
+        data, data.byteXorTables_, byte_mixing_xor_tables<Mixing>(data),
+        counter, output_states, n);
+    else if (data.usesPackedXorTables_)
+      interpret_ctr_first_round<Mixing>(data, data.packedXorTables_,
+                                        data.packedMixingXorTables_, counter,
+                                        output_states, n);
+    else
+      interpret_ctr_first_round<Mixing>(data, data.xorTables_,
+                                        data.mixingXorTables_, counter,
+                                        output_states, n);
+  }
+  }  // namespace
+
+  void interpret_white_box_ctr(const WhiteBoxData &white_box_encryption_data,
+                               const State &iv, uint64_t first_block,
+                               State *output_states, size_t n) {
+    const WhiteBoxData &data = white_box_encryption_data;
+    State counter = add_to_counter(iv, first_block);
+    if (data.usesMixingBijections_)
+      interpret_ctr_first_round<true>(data, counter, output_states, n);
+    else
+      interpret_ctr_first_round<false>(data, counter, output_states, n);
+
+    interpret_white_box_batch(data, output_states, output_states, n, false, 1);
   }
 
   void encrypt_cbc_mode(
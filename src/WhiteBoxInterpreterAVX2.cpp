@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstddef>
+
+#include <WhiteBoxInterpreter.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WHITEBOX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace WhiteBox {
+#ifdef WHITEBOX_X86_SIMD
+#define WHITEBOX_AVX2 __attribute__((target("avx2")))
+
+namespace {
+// Byte i of AVX2_BATCH_SIZE blocks, block l in 32-bit lane l. Lanes hold
+// bytes while passing between rounds and encoded words within a round.
+typedef __m256i TransposedBytes[AES_BLOCK_SIZE_BYTES];
+
+// Tables are read with 4-byte gathers at byte offsets, which read up to
+// three bytes past the entry. That stays inside WhiteBoxData: every byte
+// table is followed by another table, the last one by padding.
+static_assert(sizeof(WhiteBoxData) -
+                      offsetof(WhiteBoxData, packedMixingXorTables_) -
+                      sizeof(PackedXorTables) >=
+                  3,
+              "Gathers from the last XOR table would leave WhiteBoxData");
+
+WHITEBOX_AVX2 inline __m256i gather_xor_table(const XorTable &table,
+                                              __m256i index) {
+  return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table.data()),
+                                index, 1);
+}
+
+WHITEBOX_AVX2 inline __m256i gather_xor_table(const PackedXorTable &table,
+                                              __m256i index) {
+  // Entry i is the lower (even i) or upper (odd i) nibble of byte i / 2
+  __m256i packed = _mm256_i32gather_epi32(
+      reinterpret_cast<const int *>(table.data()), _mm256_srli_epi32(index, 1),
+      1);
+  __m256i shift =
+      _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(1)), 2);
+  return _mm256_srlv_epi32(packed, shift);
+}
+
+// xor_encoded_words in every lane: nibble k of the result is looked up in
+// tables[7 - k]. Starting with the most significant nibble, the result is
+// shifted up by one nibble per step, so no per-lane shift counts are needed.
+template <typename Table>
+WHITEBOX_AVX2 inline __m256i xor_encoded_words_avx2(const Table *tables,
+                                                    __m256i left,
+                                                    __m256i right) {
+  const __m256i low_nibble = _mm256_set1_epi32(0xF);
+  const __m256i high_nibble = _mm256_set1_epi32(0xF0);
+  __m256i result = _mm256_setzero_si256();
+
+  for (int k = 7; k >= 0; --k) {
+    // ((left_k << 4) | right_k) with left_k, right_k at bits 4k..4k+3
+    __m256i l = (k >= 1) ? _mm256_srli_epi32(left, 4 * k - 4)
+                         : _mm256_slli_epi32(left, 4);
+    __m256i r = _mm256_srli_epi32(right, 4 * k);
+    __m256i index = _mm256_or_si256(_mm256_and_si256(l, high_nibble),
+                                    _mm256_and_si256(r, low_nibble));
+    __m256i value =
+        _mm256_and_si256(gather_xor_table(tables[7 - k], index), low_nibble);
+    result = _mm256_or_si256(_mm256_slli_epi32(result, 4), value);
+  }
+  return result;
+}
+
+// xor_cascades_column in every lane
+template <typename Tables>
+WHITEBOX_AVX2 inline __m256i xor_cascades_column_avx2(
+    const Tables &xor_tables, size_t column, __m256i word_1, __m256i word_2,
+    __m256i word_3, __m256i word_4) {
+  __m256i left =
+      xor_encoded_words_avx2(&xor_tables[column * 16], word_1, word_2);
+  __m256i right =
+      xor_encoded_words_avx2(&xor_tables[column * 16 + 8], word_3, word_4);
+  return xor_encoded_words_avx2(&xor_tables[XOR_TABLE_OFFSET + column * 8],
+                                left, right);
+}
+
+// Plain XOR tables: the cascades XOR the words directly
+WHITEBOX_AVX2 inline __m256i xor_cascades_column_avx2(
+    PlainXorTables, size_t, __m256i word_1, __m256i word_2, __m256i word_3,
+    __m256i word_4) {
+  return _mm256_xor_si256(_mm256_xor_si256(word_1, word_2),
+                          _mm256_xor_si256(word_3, word_4));
+}
+
+WHITEBOX_AVX2 inline __m256i gather_word_table(
+    const std::array<uint32_t, 256> &table, __m256i index) {
+  return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table.data()),
+                                index, 4);
+}
+
+// Splits a column of big-endian words into its bytes
+WHITEBOX_AVX2 inline void store_column(__m256i column, __m256i *bytes) {
+  const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+  bytes[0] = _mm256_srli_epi32(column, 24);
+  bytes[1] = _mm256_and_si256(_mm256_srli_epi32(column, 16), byte_mask);
+  bytes[2] = _mm256_and_si256(_mm256_srli_epi32(column, 8), byte_mask);
+  bytes[3] = _mm256_and_si256(column, byte_mask);
+}
+
+// interpret_round_fused for AVX2_BATCH_SIZE blocks at once
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_AVX2 void interpret_round_avx2(const WhiteBoxData &data,
+                                        const Tables &xor_tables,
+                                        const Tables &mixing_xor_tables,
+                                        const TransposedBytes &state,
+                                        TransposedBytes &output_state,
+                                        size_t round) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  const auto &tyi_tables = data.tyiTables_[round];
+
+  for (size_t c = 0; c < 4; ++c) {
+    const size_t i = c * 4;
+    __m256i column = xor_cascades_column_avx2(
+        xor_tables[round], c, gather_word_table(tyi_tables[i], state[shift[i]]),
+        gather_word_table(tyi_tables[i + 1], state[shift[i + 1]]),
+        gather_word_table(tyi_tables[i + 2], state[shift[i + 2]]),
+        gather_word_table(tyi_tables[i + 3], state[shift[i + 3]]));
+
+    if (data.usesMixingBijections_) {
+      const auto &mixing_tables = data.mixingTables_[round];
+      __m256i bytes[4];
+      store_column(column, bytes);
+      column = xor_cascades_column_avx2(
+          mixing_xor_tables[round], c,
+          gather_word_table(mixing_tables[i], bytes[0]),
+          gather_word_table(mixing_tables[i + 1], bytes[1]),
+          gather_word_table(mixing_tables[i + 2], bytes[2]),
+          gather_word_table(mixing_tables[i + 3], bytes[3]));
+    }
+
+    store_column(column, &output_state[i]);
+  }
+}
+
+template <InterpreterDirection Direction>
+WHITEBOX_AVX2 void interpret_final_round_avx2(const WhiteBoxData &data,
+                                              const TransposedBytes &state,
+                                              TransposedBytes &output_state) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i) {
+    __m256i value = _mm256_i32gather_epi32(
+        reinterpret_cast<const int *>(data.finalRoundTBoxes_[i].data()),
+        state[shift[i]], 1);
+    output_state[i] = _mm256_and_si256(value, _mm256_set1_epi32(0xFF));
+  }
+}
+
+// Runs AVX2_BATCH_SIZE blocks through all rounds; lanes past n are padded
+// with zero blocks and dropped
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_AVX2 void interpret_white_box_avx2(const WhiteBoxData &data,
+                                            const Tables &xor_tables,
+                                            const Tables &mixing_xor_tables,
+                                            const State *input_states,
+                                            State *output_states, size_t n,
+                                            size_t first_round) {
+  alignas(32) std::array<std::array<uint32_t, AVX2_BATCH_SIZE>,
+                         AES_BLOCK_SIZE_BYTES> lanes{};
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      lanes[i][l] = input_states[l][i];
+
+  TransposedBytes state;
+  TransposedBytes round_state;
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    state[i] = _mm256_load_si256(reinterpret_cast<const __m256i *>(&lanes[i]));
+
+  // Rounds before first_round are skipped; the rest alternate between
+  // state and round_state
+  size_t round = first_round;
+  for (; round + 1 < 9; round += 2) {
+    interpret_round_avx2<Direction>(data, xor_tables, mixing_xor_tables,
+                                    state, round_state, round);
+    interpret_round_avx2<Direction>(data, xor_tables, mixing_xor_tables,
+                                    round_state, state, round + 1);
+  }
+  TransposedBytes *result = &state;
+  if (round < 9) {
+    interpret_round_avx2<Direction>(data, xor_tables, mixing_xor_tables,
+                                    state, round_state, round);
+    interpret_final_round_avx2<Direction>(data, round_state, state);
+  } else {
+    interpret_final_round_avx2<Direction>(data, state, round_state);
+    result = &round_state;
+  }
+
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    _mm256_store_si256(reinterpret_cast<__m256i *>(&lanes[i]), (*result)[i]);
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      output_states[l][i] = static_cast<uint8_t>(lanes[i][l]);
+}
+
+// Runs all batches in Direction, on the XOR table layout of the tables
+template <InterpreterDirection Direction>
+WHITEBOX_AVX2 void interpret_batches_avx2(const WhiteBoxData &data,
+                                          const State *input_states,
+                                          State *output_states, size_t n,
+                                          size_t first_round) {
+  for (size_t i = 0; i < n; i += AVX2_BATCH_SIZE) {
+    size_t lanes = std::min(AVX2_BATCH_SIZE, n - i);
+    if (data.usesPlainXorTables_)
+      interpret_white_box_avx2<Direction>(data, PlainXorTables(),
+                                          PlainXorTables(), input_states + i,
+                                          output_states + i, lanes,
+                                          first_round);
+    else if (data.usesPackedXorTables_)
+      interpret_white_box_avx2<Direction>(
+          data, data.packedXorTables_, data.packedMixingXorTables_,
+          input_states + i, output_states + i, lanes, first_round);
+    else
+      interpret_white_box_avx2<Direction>(
+          data, data.xorTables_, data.mixingXorTables_, input_states + i,
+          output_states + i, lanes, first_round);
+  }
+}
+}  // namespace
+
+bool cpu_supports_avx2() { return __builtin_cpu_supports("avx2") != 0; }
+
+void interpret_white_box_batch_avx2(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  if (decrypt)
+    interpret_batches_avx2<InterpreterDirection::DECRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+  else
+    interpret_batches_avx2<InterpreterDirection::ENCRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+}
+#else
+bool cpu_supports_avx2() { return false; }
+
+void interpret_white_box_batch_avx2(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  interpret_white_box_batch_scalar(white_box_encryption_data, input_states,
+                                   output_states, n, decrypt, first_round);
+}
+#endif
+}  // namespace WhiteBox
@@ -0,0 +1,303 @@
+#include <algorithm>
+
+#include <WhiteBoxInterpreter.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WHITEBOX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace WhiteBox {
+#ifdef WHITEBOX_X86_SIMD
+#define WHITEBOX_AVX512 \
+  __attribute__((target("avx512f,avx512bw,avx512vbmi")))
+
+namespace {
+// Byte i of AVX512_BATCH_SIZE blocks, block l in byte lane l
+typedef __m512i TransposedBytes[AES_BLOCK_SIZE_BYTES];
+
+// An encoded 32-bit word of every block as 4 byte lanes, most significant
+// byte first, matching the big-endian order of the columns
+typedef __m512i WordBytes[4];
+
+// A whole 256-entry XOR table, or a 128-byte packed one, held in registers
+// so that the lookups of all lanes are vpermi2b instead of memory accesses
+struct RegisterXorTable {
+  __m512i low_;
+  __m512i high_;
+  __m512i low2_;
+  __m512i high2_;
+};
+
+WHITEBOX_AVX512 inline void load_xor_table(const XorTable &table,
+                                           RegisterXorTable *registers) {
+  registers->low_ = _mm512_loadu_si512(table.data());
+  registers->high_ = _mm512_loadu_si512(table.data() + 64);
+  registers->low2_ = _mm512_loadu_si512(table.data() + 128);
+  registers->high2_ = _mm512_loadu_si512(table.data() + 192);
+}
+
+WHITEBOX_AVX512 inline void load_xor_table(const PackedXorTable &table,
+                                           RegisterXorTable *registers) {
+  registers->low_ = _mm512_loadu_si512(table.data());
+  registers->high_ = _mm512_loadu_si512(table.data() + 64);
+}
+
+// 256-entry lookup: vpermi2b covers 128 entries with the low 7 index bits,
+// the top bit selects between the two halves
+WHITEBOX_AVX512 inline __m512i lookup_xor_table(const XorTable &,
+                                                const RegisterXorTable &table,
+                                                __m512i index) {
+  __m512i low = _mm512_permutex2var_epi8(table.low_, index, table.high_);
+  __m512i high = _mm512_permutex2var_epi8(table.low2_, index, table.high2_);
+  return _mm512_mask_blend_epi8(_mm512_movepi8_mask(index), low, high);
+}
+
+// Packed lookup: byte index / 2 holds entry index in its lower (even) or
+// upper (odd) nibble
+WHITEBOX_AVX512 inline __m512i lookup_xor_table(const PackedXorTable &,
+                                                const RegisterXorTable &table,
+                                                __m512i index) {
+  const __m512i low_nibble = _mm512_set1_epi8(0xF);
+  __m512i byte_index =
+      _mm512_and_si512(_mm512_srli_epi16(index, 1), _mm512_set1_epi8(0x7F));
+  __m512i packed = _mm512_permutex2var_epi8(table.low_, byte_index, table.high_);
+  __mmask64 odd = _mm512_test_epi8_mask(index, _mm512_set1_epi8(1));
+  return _mm512_mask_blend_epi8(
+      odd, _mm512_and_si512(packed, low_nibble),
+      _mm512_and_si512(_mm512_srli_epi16(packed, 4), low_nibble));
+}
+
+// xor_encoded_words on byte lanes: nibble k of the words is looked up in
+// tables[7 - k], i.e. byte j of the words uses tables[2 * j] for its upper
+// and tables[2 * j + 1] for its lower nibble
+template <typename Table>
+WHITEBOX_AVX512 inline void xor_encoded_words_avx512(const Table *tables,
+                                                     const WordBytes &left,
+                                                     const WordBytes &right,
+                                                     WordBytes &result) {
+  const __m512i low_nibble = _mm512_set1_epi8(0xF);
+  const __m512i high_nibble = _mm512_set1_epi8(static_cast<char>(0xF0));
+
+  for (size_t j = 0; j < 4; ++j) {
+    RegisterXorTable upper_table;
+    RegisterXorTable lower_table;
+    load_xor_table(tables[2 * j], &upper_table);
+    load_xor_table(tables[2 * j + 1], &lower_table);
+
+    // (left_nibble << 4) | right_nibble for both nibbles of the byte
+    __m512i upper_index = _mm512_or_si512(
+        _mm512_and_si512(left[j], high_nibble),
+        _mm512_and_si512(_mm512_srli_epi16(right[j], 4), low_nibble));
+    __m512i lower_index = _mm512_or_si512(
+        _mm512_and_si512(_mm512_slli_epi16(left[j], 4), high_nibble),
+        _mm512_and_si512(right[j], low_nibble));
+
+    __m512i upper = lookup_xor_table(tables[2 * j], upper_table, upper_index);
+    __m512i lower = lookup_xor_table(tables[2 * j + 1], lower_table,
+                                     lower_index);
+    result[j] = _mm512_or_si512(
+        _mm512_and_si512(_mm512_slli_epi16(upper, 4), high_nibble), lower);
+  }
+}
+
+// xor_cascades_column on byte lanes
+template <typename Tables>
+WHITEBOX_AVX512 inline void xor_cascades_column_avx512(
+    const Tables &xor_tables, size_t column, const WordBytes *words,
+    WordBytes &result) {
+  WordBytes left;
+  WordBytes right;
+  xor_encoded_words_avx512(&xor_tables[column * 16], words[0], words[1], left);
+  xor_encoded_words_avx512(&xor_tables[column * 16 + 8], words[2], words[3],
+                           right);
+  xor_encoded_words_avx512(&xor_tables[XOR_TABLE_OFFSET + column * 8], left,
+                           right, result);
+}
+
+// Plain XOR tables: the cascades XOR the words directly
+WHITEBOX_AVX512 inline void xor_cascades_column_avx512(PlainXorTables, size_t,
+                                                       const WordBytes *words,
+                                                       WordBytes &result) {
+  for (size_t j = 0; j < 4; ++j)
+    result[j] = _mm512_xor_si512(_mm512_xor_si512(words[0][j], words[1][j]),
+                                 _mm512_xor_si512(words[2][j], words[3][j]));
+}
+
+// Byte shift of every 32-bit lane of words, narrowed to one byte per lane
+WHITEBOX_AVX512 inline __m128i word_byte(__m512i words, unsigned int shift) {
+  return _mm512_cvtepi32_epi8(_mm512_srli_epi32(words, shift));
+}
+
+WHITEBOX_AVX512 inline __m512i combine_quarters(__m128i q0, __m128i q1,
+                                                __m128i q2, __m128i q3) {
+  __m512i result = _mm512_castsi128_si512(q0);
+  result = _mm512_inserti32x4(result, q1, 1);
+  result = _mm512_inserti32x4(result, q2, 2);
+  return _mm512_inserti32x4(result, q3, 3);
+}
+
+// Looks up a table of 32-bit words (Tyi or mixing table) for all byte
+// lanes; 32-bit entries do not fit the byte permutes, so these are gathers
+// of 16 lanes each, narrowed back to byte lanes afterwards
+WHITEBOX_AVX512 inline void gather_word_table(
+    const std::array<uint32_t, 256> &table, __m512i index, WordBytes &bytes) {
+  const auto *base = reinterpret_cast<const int *>(table.data());
+  __m512i w0 = _mm512_i32gather_epi32(
+      _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(index, 0)), base, 4);
+  __m512i w1 = _mm512_i32gather_epi32(
+      _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(index, 1)), base, 4);
+  __m512i w2 = _mm512_i32gather_epi32(
+      _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(index, 2)), base, 4);
+  __m512i w3 = _mm512_i32gather_epi32(
+      _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(index, 3)), base, 4);
+
+  for (unsigned int j = 0; j < 4; ++j) {
+    unsigned int shift = 24 - 8 * j;
+    bytes[j] = combine_quarters(word_byte(w0, shift), word_byte(w1, shift),
+                                word_byte(w2, shift), word_byte(w3, shift));
+  }
+}
+
+// interpret_round_fused for AVX512_BATCH_SIZE blocks at once
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_AVX512 void interpret_round_avx512(const WhiteBoxData &data,
+                                            const Tables &xor_tables,
+                                            const Tables &mixing_xor_tables,
+                                            const TransposedBytes &state,
+                                            TransposedBytes &output_state,
+                                            size_t round) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  const auto &tyi_tables = data.tyiTables_[round];
+
+  for (size_t c = 0; c < 4; ++c) {
+    const size_t i = c * 4;
+    WordBytes words[4];
+    WordBytes column;
+    for (size_t k = 0; k < 4; ++k)
+      gather_word_table(tyi_tables[i + k], state[shift[i + k]], words[k]);
+    xor_cascades_column_avx512(xor_tables[round], c, words, column);
+
+    if (data.usesMixingBijections_) {
+      const auto &mixing_tables = data.mixingTables_[round];
+      for (size_t k = 0; k < 4; ++k)
+        gather_word_table(mixing_tables[i + k], column[k], words[k]);
+      xor_cascades_column_avx512(mixing_xor_tables[round], c, words, column);
+    }
+
+    for (size_t k = 0; k < 4; ++k) output_state[i + k] = column[k];
+  }
+}
+
+template <InterpreterDirection Direction>
+WHITEBOX_AVX512 void interpret_final_round_avx512(
+    const WhiteBoxData &data, const TransposedBytes &state,
+    TransposedBytes &output_state) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i) {
+    // The T-boxes are byte tables just like the XOR tables
+    const TBox &t_box = data.finalRoundTBoxes_[i];
+    RegisterXorTable registers;
+    load_xor_table(t_box, &registers);
+    output_state[i] = lookup_xor_table(t_box, registers, state[shift[i]]);
+  }
+}
+
+// Runs AVX512_BATCH_SIZE blocks through all rounds; lanes past n are
+// padded with zero blocks and dropped
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_AVX512 void interpret_white_box_avx512(
+    const WhiteBoxData &data, const Tables &xor_tables,
+    const Tables &mixing_xor_tables, const State *input_states,
+    State *output_states, size_t n, size_t first_round) {
+  alignas(64) std::array<std::array<uint8_t, AVX512_BATCH_SIZE>,
+                         AES_BLOCK_SIZE_BYTES> lanes{};
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      lanes[i][l] = input_states[l][i];
+
+  TransposedBytes state;
+  TransposedBytes round_state;
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    state[i] = _mm512_load_si512(lanes[i].data());
+
+  // Rounds before first_round are skipped; the rest alternate between
+  // state and round_state
+  size_t round = first_round;
+  for (; round + 1 < 9; round += 2) {
+    interpret_round_avx512<Direction>(data, xor_tables, mixing_xor_tables,
+                                      state, round_state, round);
+    interpret_round_avx512<Direction>(data, xor_tables, mixing_xor_tables,
+                                      round_state, state, round + 1);
+  }
+  TransposedBytes *result = &state;
+  if (round < 9) {
+    interpret_round_avx512<Direction>(data, xor_tables, mixing_xor_tables,
+                                      state, round_state, round);
+    interpret_final_round_avx512<Direction>(data, round_state, state);
+  } else {
+    interpret_final_round_avx512<Direction>(data, state, round_state);
+    result = &round_state;
+  }
+
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    _mm512_store_si512(lanes[i].data(), (*result)[i]);
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      output_states[l][i] = lanes[i][l];
+}
+
+// Runs all batches in Direction, on the XOR table layout of the tables
+template <InterpreterDirection Direction>
+WHITEBOX_AVX512 void interpret_batches_avx512(const WhiteBoxData &data,
+                                              const State *input_states,
+                                              State *output_states, size_t n,
+                                              size_t first_round) {
+  for (size_t i = 0; i < n; i += AVX512_BATCH_SIZE) {
+    size_t lanes = std::min(AVX512_BATCH_SIZE, n - i);
+    if (data.usesPlainXorTables_)
+      interpret_white_box_avx512<Direction>(data, PlainXorTables(),
+                                            PlainXorTables(), input_states + i,
+                                            output_states + i, lanes,
+                                            first_round);
+    else if (data.usesPackedXorTables_)
+      interpret_white_box_avx512<Direction>(
+          data, data.packedXorTables_, data.packedMixingXorTables_,
+          input_states + i, output_states + i, lanes, first_round);
+    else
+      interpret_white_box_avx512<Direction>(
+          data, data.xorTables_, data.mixingXorTables_, input_states + i,
+          output_states + i, lanes, first_round);
+  }
+}
+}  // namespace
+
+bool cpu_supports_avx512_vbmi() {
+  return __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx512bw") &&
+         __builtin_cpu_supports("avx512vbmi");
+}
+
+void interpret_white_box_batch_avx512(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  if (decrypt)
+    interpret_batches_avx512<InterpreterDirection::DECRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+  else
+    interpret_batches_avx512<InterpreterDirection::ENCRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+}
+#else
+bool cpu_supports_avx512_vbmi() { return false; }
+
+void interpret_white_box_batch_avx512(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  interpret_white_box_batch_scalar(white_box_encryption_data, input_states,
+                                   output_states, n, decrypt, first_round);
+}
+#endif
+}  // namespace WhiteBox
@@ -0,0 +1,241 @@
+#include <algorithm>
+
+#include <WhiteBoxInterpreter.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WHITEBOX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace WhiteBox {
+#ifdef WHITEBOX_X86_SIMD
+#define WHITEBOX_SSE4 __attribute__((target("sse4.1")))
+
+namespace {
+// Byte i of SSE4_BATCH_SIZE blocks, block l in 32-bit lane l, as in the
+// AVX2 interpreter
+typedef __m128i TransposedBytes[AES_BLOCK_SIZE_BYTES];
+
+// There are no gathers before AVX2; the four lanes are looked up one by one
+// and inserted, while the index arithmetic stays vectorized
+template <typename Entry>
+WHITEBOX_SSE4 inline __m128i gather_lanes(const Entry *table, __m128i index) {
+  return _mm_setr_epi32(static_cast<int>(table[_mm_cvtsi128_si32(index)]),
+                        static_cast<int>(table[_mm_extract_epi32(index, 1)]),
+                        static_cast<int>(table[_mm_extract_epi32(index, 2)]),
+                        static_cast<int>(table[_mm_extract_epi32(index, 3)]));
+}
+
+WHITEBOX_SSE4 inline __m128i gather_xor_table(const XorTable &table,
+                                              __m128i index) {
+  return gather_lanes(table.data(), index);
+}
+
+WHITEBOX_SSE4 inline __m128i gather_xor_table(const PackedXorTable &table,
+                                              __m128i index) {
+  // Entry i is the lower (even i) or upper (odd i) nibble of byte i / 2;
+  // without per-lane shifts, both are computed and blended
+  __m128i packed = gather_lanes(table.data(), _mm_srli_epi32(index, 1));
+  __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(index, _mm_set1_epi32(1)),
+                                _mm_set1_epi32(1));
+  return _mm_blendv_epi8(packed, _mm_srli_epi32(packed, 4), odd);
+}
+
+// xor_encoded_words in every lane, see xor_encoded_words_avx2
+template <typename Table>
+WHITEBOX_SSE4 inline __m128i xor_encoded_words_sse4(const Table *tables,
+                                                    __m128i left,
+                                                    __m128i right) {
+  const __m128i low_nibble = _mm_set1_epi32(0xF);
+  const __m128i high_nibble = _mm_set1_epi32(0xF0);
+  __m128i result = _mm_setzero_si128();
+
+  for (int k = 7; k >= 0; --k) {
+    __m128i l = (k >= 1) ? _mm_srli_epi32(left, 4 * k - 4)
+                         : _mm_slli_epi32(left, 4);
+    __m128i r = _mm_srli_epi32(right, 4 * k);
+    __m128i index = _mm_or_si128(_mm_and_si128(l, high_nibble),
+                                 _mm_and_si128(r, low_nibble));
+    __m128i value =
+        _mm_and_si128(gather_xor_table(tables[7 - k], index), low_nibble);
+    result = _mm_or_si128(_mm_slli_epi32(result, 4), value);
+  }
+  return result;
+}
+
+// xor_cascades_column in every lane
+template <typename Tables>
+WHITEBOX_SSE4 inline __m128i xor_cascades_column_sse4(
+    const Tables &xor_tables, size_t column, __m128i word_1, __m128i word_2,
+    __m128i word_3, __m128i word_4) {
+  __m128i left =
+      xor_encoded_words_sse4(&xor_tables[column * 16], word_1, word_2);
+  __m128i right =
+      xor_encoded_words_sse4(&xor_tables[column * 16 + 8], word_3, word_4);
+  return xor_encoded_words_sse4(&xor_tables[XOR_TABLE_OFFSET + column * 8],
+                                left, right);
+}
+
+// Plain XOR tables: the cascades XOR the words directly
+WHITEBOX_SSE4 inline __m128i xor_cascades_column_sse4(
+    PlainXorTables, size_t, __m128i word_1, __m128i word_2, __m128i word_3,
+    __m128i word_4) {
+  return _mm_xor_si128(_mm_xor_si128(word_1, word_2),
+                       _mm_xor_si128(word_3, word_4));
+}
+
+WHITEBOX_SSE4 inline __m128i gather_word_table(
+    const std::array<uint32_t, 256> &table, __m128i index) {
+  return gather_lanes(table.data(), index);
+}
+
+// Splits a column of big-endian words into its bytes
+WHITEBOX_SSE4 inline void store_column(__m128i column, __m128i *bytes) {
+  const __m128i byte_mask = _mm_set1_epi32(0xFF);
+  bytes[0] = _mm_srli_epi32(column, 24);
+  bytes[1] = _mm_and_si128(_mm_srli_epi32(column, 16), byte_mask);
+  bytes[2] = _mm_and_si128(_mm_srli_epi32(column, 8), byte_mask);
+  bytes[3] = _mm_and_si128(column, byte_mask);
+}
+
+// interpret_round_fused for SSE4_BATCH_SIZE blocks at once
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_SSE4 void interpret_round_sse4(const WhiteBoxData &data,
+                                        const Tables &xor_tables,
+                                        const Tables &mixing_xor_tables,
+                                        const TransposedBytes &state,
+                                        TransposedBytes &output_state,
+                                        size_t round) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  const auto &tyi_tables = data.tyiTables_[round];
+
+  for (size_t c = 0; c < 4; ++c) {
+    const size_t i = c * 4;
+    __m128i column = xor_cascades_column_sse4(
+        xor_tables[round], c, gather_word_table(tyi_tables[i], state[shift[i]]),
+        gather_word_table(tyi_tables[i + 1], state[shift[i + 1]]),
+        gather_word_table(tyi_tables[i + 2], state[shift[i + 2]]),
+        gather_word_table(tyi_tables[i + 3], state[shift[i + 3]]));
+
+    if (data.usesMixingBijections_) {
+      const auto &mixing_tables = data.mixingTables_[round];
+      __m128i bytes[4];
+      store_column(column, bytes);
+      column = xor_cascades_column_sse4(
+          mixing_xor_tables[round], c,
+          gather_word_table(mixing_tables[i], bytes[0]),
+          gather_word_table(mixing_tables[i + 1], bytes[1]),
+          gather_word_table(mixing_tables[i + 2], bytes[2]),
+          gather_word_table(mixing_tables[i + 3], bytes[3]));
+    }
+
+    store_column(column, &output_state[i]);
+  }
+}
+
+template <InterpreterDirection Direction>
+WHITEBOX_SSE4 void interpret_final_round_sse4(const WhiteBoxData &data,
+                                              const TransposedBytes &state,
+                                              TransposedBytes &output_state) {
+  constexpr const auto &shift = shift_rows_indices<Direction>();
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    output_state[i] =
+        gather_lanes(data.finalRoundTBoxes_[i].data(), state[shift[i]]);
+}
+
+// Runs SSE4_BATCH_SIZE blocks through all rounds; lanes past n are padded
+// with zero blocks and dropped
+template <InterpreterDirection Direction, typename Tables>
+WHITEBOX_SSE4 void interpret_white_box_sse4(const WhiteBoxData &data,
+                                            const Tables &xor_tables,
+                                            const Tables &mixing_xor_tables,
+                                            const State *input_states,
+                                            State *output_states, size_t n,
+                                            size_t first_round) {
+  alignas(16) std::array<std::array<uint32_t, SSE4_BATCH_SIZE>,
+                         AES_BLOCK_SIZE_BYTES> lanes{};
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      lanes[i][l] = input_states[l][i];
+
+  TransposedBytes state;
+  TransposedBytes round_state;
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    state[i] = _mm_load_si128(reinterpret_cast<const __m128i *>(&lanes[i]));
+
+  // Rounds before first_round are skipped; the rest alternate between
+  // state and round_state
+  size_t round = first_round;
+  for (; round + 1 < 9; round += 2) {
+    interpret_round_sse4<Direction>(data, xor_tables, mixing_xor_tables,
+                                    state, round_state, round);
+    interpret_round_sse4<Direction>(data, xor_tables, mixing_xor_tables,
+                                    round_state, state, round + 1);
+  }
+  TransposedBytes *result = &state;
+  if (round < 9) {
+    interpret_round_sse4<Direction>(data, xor_tables, mixing_xor_tables,
+                                    state, round_state, round);
+    interpret_final_round_sse4<Direction>(data, round_state, state);
+  } else {
+    interpret_final_round_sse4<Direction>(data, state, round_state);
+    result = &round_state;
+  }
+
+  for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+    _mm_store_si128(reinterpret_cast<__m128i *>(&lanes[i]), (*result)[i]);
+  for (size_t l = 0; l < n; ++l)
+    for (size_t i = 0; i < AES_BLOCK_SIZE_BYTES; ++i)
+      output_states[l][i] = static_cast<uint8_t>(lanes[i][l]);
+}
+
+// Runs all batches in Direction, on the XOR table layout of the tables
+template <InterpreterDirection Direction>
+WHITEBOX_SSE4 void interpret_batches_sse4(const WhiteBoxData &data,
+                                          const State *input_states,
+                                          State *output_states, size_t n,
+                                          size_t first_round) {
+  for (size_t i = 0; i < n; i += SSE4_BATCH_SIZE) {
+    size_t lanes = std::min(SSE4_BATCH_SIZE, n - i);
+    if (data.usesPlainXorTables_)
+      interpret_white_box_sse4<Direction>(data, PlainXorTables(),
+                                          PlainXorTables(), input_states + i,
+                                          output_states + i, lanes,
+                                          first_round);
+    else if (data.usesPackedXorTables_)
+      interpret_white_box_sse4<Direction>(
+          data, data.packedXorTables_, data.packedMixingXorTables_,
+          input_states + i, output_states + i, lanes, first_round);
+    else
+      interpret_white_box_sse4<Direction>(
+          data, data.xorTables_, data.mixingXorTables_, input_states + i,
+          output_states + i, lanes, first_round);
+  }
+}
+}  // namespace
+
+bool cpu_supports_sse4() { return __builtin_cpu_supports("sse4.1") != 0; }
+
+void interpret_white_box_batch_sse4(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  if (decrypt)
+    interpret_batches_sse4<InterpreterDirection::DECRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+  else
+    interpret_batches_sse4<InterpreterDirection::ENCRYPT>(
+        white_box_encryption_data, input_states, output_states, n,
+        first_round);
+}
+#else
+bool cpu_supports_sse4() { return false; }
+
+void interpret_white_box_batch_sse4(
+    const WhiteBoxData &white_box_encryption_data, const State *input_states,
+    State *output_states, size_t n, bool decrypt, size_t first_round) {
+  interpret_white_box_batch_scalar(white_box_encryption_data, input_states,
+                                   output_states, n, decrypt, first_round);
+}
+#endif
+}  // namespace WhiteBox
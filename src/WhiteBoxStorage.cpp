@@ -0,0 +1,478 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <WhiteBoxInterpreter.h>
+#include <WhiteBoxStorage.h>
+
+namespace WhiteBox {
+namespace {
+// The header comes first, the WhiteBoxData image right after it
+constexpr uint64_t BINARY_TABLE_DATA_OFFSET =
+    (sizeof(BinaryTableHeader) + alignof(WhiteBoxData) - 1) /
+    alignof(WhiteBoxData) * alignof(WhiteBoxData);
+
+// Version 1 files kept the header on a page of its own and stored
+// NUM_ROUNDS_AES_128 rounds of the round tables
+constexpr uint32_t LEGACY_BINARY_TABLE_VERSION = 1;
+
+// Where the table stored in a section lives in WhiteBoxData
+struct TableSectionLayout {
+  size_t offset_;
+  size_t size_;
+  // Size of the section in version 1 files; the tables are a prefix of it
+  size_t legacySize_;
+  // Stored only for tables with mixing bijections
+  bool mixing_;
+};
+
+constexpr size_t legacy_size(size_t size) {
+  return size / NUM_TABLE_ROUNDS_AES_128 * NUM_ROUNDS_AES_128;
+}
+
+// Sections in the order they appear in the header and in WhiteBoxData
+constexpr std::array<TableSectionLayout, BINARY_TABLE_SECTIONS>
+    TABLE_SECTION_LAYOUTS = {{
+        {offsetof(WhiteBoxData, finalRoundTBoxes_), sizeof(RoundTBoxes),
+         sizeof(RoundTBoxes), false},
+        {offsetof(WhiteBoxData, tyiTables_), sizeof(TyiTables),
+         legacy_size(sizeof(TyiTables)), false},
+        {offsetof(WhiteBoxData, xorTables_), sizeof(XorTables),
+         legacy_size(sizeof(XorTables)), false},
+        {offsetof(WhiteBoxData, mixingTables_), sizeof(MixingTables),
+         legacy_size(sizeof(MixingTables)), true},
+        {offsetof(WhiteBoxData, mixingXorTables_), sizeof(XorTables),
+         legacy_size(sizeof(XorTables)), true},
+    }};
+
+// Sections of a file written for tables with or without mixing bijections;
+// tables that are not used are stored with size 0
+std::array<BinaryTableSection, BINARY_TABLE_SECTIONS> table_sections(
+    bool mixing) {
+  std::array<BinaryTableSection, BINARY_TABLE_SECTIONS> sections{};
+  for (size_t i = 0; i < BINARY_TABLE_SECTIONS; ++i) {
+    const auto &layout = TABLE_SECTION_LAYOUTS[i];
+    sections[i].offset_ = BINARY_TABLE_DATA_OFFSET + layout.offset_;
+    sections[i].size_ = (layout.mixing_ && !mixing) ? 0 : layout.size_;
+  }
+  return sections;
+}
+
+// Bytes of WhiteBoxData up to the end of the last stored section; the
+// unused tables after it are not part of the file
+uint64_t stored_data_size(
+    const std::array<BinaryTableSection, BINARY_TABLE_SECTIONS> &sections) {
+  uint64_t end = BINARY_TABLE_DATA_OFFSET;
+  for (const auto &section : sections)
+    if (section.size_ > 0) end = std::max(end, section.offset_ + section.size_);
+  return end - BINARY_TABLE_DATA_OFFSET;
+}
+
+uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t sections_checksum(
+    const uint8_t *file,
+    const std::array<BinaryTableSection, BINARY_TABLE_SECTIONS> &sections) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const auto &section : sections)
+    hash = fnv1a(hash, file + section.offset_, section.size_);
+  return hash;
+}
+
+typedef std::vector<std::pair<const void *, size_t>> TableRanges;
+
+// XOR tables the interpreter reads for data, none if they are plain
+void add_xor_tables(const WhiteBoxData &data, bool mixing,
+                    TableRanges *sections) {
+  if (data.usesPlainXorTables_) return;
+  if (data.xorGranularity_ == TableGranularity::BYTE)
+    sections->emplace_back((mixing) ? &data.byteMixingXorTables_
+                                    : &data.byteXorTables_,
+                           sizeof(ByteXorTables));
+  else if (data.usesPackedXorTables_)
+    sections->emplace_back((mixing) ? &data.packedMixingXorTables_
+                                    : &data.packedXorTables_,
+                           sizeof(PackedXorTables));
+  else
+    sections->emplace_back(
+        (mixing) ? &data.mixingXorTables_ : &data.xorTables_,
+        sizeof(XorTables));
+}
+
+// Tables the interpreter reads for data, as address ranges
+TableRanges interpreter_sections(const WhiteBoxData &data) {
+  TableRanges sections = {{&data.finalRoundTBoxes_, sizeof(RoundTBoxes)},
+                          {&data.tyiTables_, sizeof(TyiTables)}};
+  add_xor_tables(data, false, &sections);
+  if (data.usesMixingBijections_) {
+    sections.emplace_back(&data.mixingTables_, sizeof(MixingTables));
+    add_xor_tables(data, true, &sections);
+  }
+  return sections;
+}
+
+void run_dummy_blocks(const WhiteBoxData &data, size_t num_blocks) {
+  std::vector<State> states(num_blocks);
+  for (size_t i = 0; i < num_blocks; ++i)
+    states[i].fill(static_cast<uint8_t>(i));
+  // The direction of the tables is not recorded; either direction reads
+  // the same tables
+  interpret_white_box_batch(data, states.data(), states.data(), num_blocks,
+                            false);
+}
+
+size_t round_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// Anonymous zero-filled memory of *mapping_size bytes (size rounded up to
+// HUGE_PAGE_SIZE) on huge pages where the system provides them
+void *map_huge_pages(size_t size, size_t *mapping_size) {
+  *mapping_size = round_up(size, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+  void *mapping = mmap(nullptr, *mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mapping != MAP_FAILED) return mapping;
+#endif
+
+  // No reserved huge pages: transparent huge pages need a HUGE_PAGE_SIZE
+  // aligned range, so one page more is mapped and the ends are trimmed
+  size_t padded_size = *mapping_size + HUGE_PAGE_SIZE;
+  void *padded = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (padded == MAP_FAILED) return nullptr;
+
+  auto start = reinterpret_cast<uintptr_t>(padded);
+  auto aligned = round_up(start, HUGE_PAGE_SIZE);
+  if (aligned > start) munmap(padded, aligned - start);
+  size_t tail = start + padded_size - (aligned + *mapping_size);
+  if (tail > 0)
+    munmap(reinterpret_cast<void *>(aligned + *mapping_size), tail);
+
+#ifdef MADV_HUGEPAGE
+  // Only a hint; without transparent huge pages the range stays usable
+  madvise(reinterpret_cast<void *>(aligned), *mapping_size, MADV_HUGEPAGE);
+#endif
+  return reinterpret_cast<void *>(aligned);
+}
+
+// Reads size bytes from the start of the file
+bool read_file(int fd, void *destination, size_t size) {
+  auto *bytes = static_cast<uint8_t *>(destination);
+  size_t offset = 0;
+  while (offset < size) {
+    ssize_t n =
+        pread(fd, bytes + offset, size - offset, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    offset += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool check_header(const BinaryTableHeader &header) {
+  if (header.magic_ != BINARY_TABLE_MAGIC) {
+    std::cerr << "Not a binary white box table file" << std::endl;
+    return false;
+  }
+  if (header.byteOrder_ != BINARY_TABLE_BYTE_ORDER) {
+    std::cerr << "Binary table file was written with a different byte order"
+              << std::endl;
+    return false;
+  }
+  if (header.version_ != BINARY_TABLE_VERSION &&
+      header.version_ != LEGACY_BINARY_TABLE_VERSION) {
+    std::cerr << "Unsupported binary table version " << header.version_
+              << std::endl;
+    return false;
+  }
+  if (header.numSections_ != BINARY_TABLE_SECTIONS) {
+    std::cerr << "Binary table file does not match the table layout"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// The file is used in place, so its layout has to be the one of this build
+bool check_layout(const BinaryTableHeader &header, size_t file_size) {
+  bool mixing = (header.flags_ & BINARY_TABLE_FLAG_MIXING) != 0;
+  auto sections = table_sections(mixing);
+  bool matches = header.dataOffset_ == BINARY_TABLE_DATA_OFFSET &&
+                 header.dataSize_ == stored_data_size(sections);
+  for (size_t i = 0; i < BINARY_TABLE_SECTIONS; ++i) {
+    matches = matches && header.sections_[i].offset_ == sections[i].offset_ &&
+              header.sections_[i].size_ == sections[i].size_;
+  }
+  if (!matches) {
+    std::cerr << "Binary table file does not match the table layout"
+              << std::endl;
+    return false;
+  }
+  if (file_size < header.dataOffset_ + header.dataSize_) {
+    std::cerr << "Binary table file is truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Version 1 files are copied instead, so only the sizes of the sections
+// matter
+bool check_legacy_layout(const BinaryTableHeader &header, size_t file_size) {
+  for (size_t i = 0; i < BINARY_TABLE_SECTIONS; ++i) {
+    const auto &section = header.sections_[i];
+    if (section.size_ != TABLE_SECTION_LAYOUTS[i].legacySize_) {
+      std::cerr << "Binary table file does not match the table layout"
+                << std::endl;
+      return false;
+    }
+    if (section.offset_ > file_size ||
+        file_size - section.offset_ < section.size_) {
+      std::cerr << "Binary table file is truncated" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool check_checksum(const BinaryTableHeader &header, const uint8_t *file) {
+  if (sections_checksum(file, header.sections_) != header.checksum_) {
+    std::cerr << "Binary table file is corrupted (checksum mismatch)"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Copies the tables of a version 1 file into newly allocated data
+WhiteBoxDataPtr load_legacy_table(int fd, const BinaryTableHeader &header,
+                                  size_t file_size, bool huge_pages) {
+  if (!check_legacy_layout(header, file_size)) return nullptr;
+
+  void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Could not map white box table file" << std::endl;
+    return nullptr;
+  }
+  const auto *file = static_cast<const uint8_t *>(mapping);
+
+  WhiteBoxDataPtr data;
+  if (check_checksum(header, file)) data = allocate_white_box_data(huge_pages);
+  if (data) {
+    data->usesMixingBijections_ =
+        (header.flags_ & BINARY_TABLE_FLAG_MIXING) != 0;
+    auto *image = reinterpret_cast<uint8_t *>(data.get());
+    for (size_t i = 0; i < BINARY_TABLE_SECTIONS; ++i) {
+      const auto &layout = TABLE_SECTION_LAYOUTS[i];
+      if (layout.mixing_ && !data->usesMixingBijections_) continue;
+      std::copy_n(file + header.sections_[i].offset_, layout.size_,
+                  image + layout.offset_);
+    }
+  }
+  munmap(mapping, file_size);
+  return data;
+}
+}  // namespace
+
+void WhiteBoxDataDeleter::operator()(WhiteBoxData *data) const {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mappingSize_);
+  } else {
+    delete data;
+  }
+}
+
+WhiteBoxDataPtr allocate_white_box_data(bool huge_pages) {
+  // Anonymous memory is zero-filled as it is first touched, so the derived
+  // tables take no space until they are filled
+  WhiteBoxDataDeleter deleter;
+  if (huge_pages) {
+    deleter.mapping_ =
+        map_huge_pages(sizeof(WhiteBoxData), &deleter.mappingSize_);
+  } else {
+    deleter.mappingSize_ = sizeof(WhiteBoxData);
+    deleter.mapping_ = mmap(nullptr, deleter.mappingSize_,
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (deleter.mapping_ == MAP_FAILED) deleter.mapping_ = nullptr;
+  }
+  if (deleter.mapping_ == nullptr) {
+    std::cerr << "Could not map memory for the white box tables" << std::endl;
+    return nullptr;
+  }
+  // Default initialization keeps the zeros instead of writing them again
+  return WhiteBoxDataPtr(new (deleter.mapping_) WhiteBoxData, deleter);
+}
+
+bool write_binary_table(const WhiteBoxData &data, std::ostream &o) {
+  BinaryTableHeader header{};
+  header.magic_ = BINARY_TABLE_MAGIC;
+  header.version_ = BINARY_TABLE_VERSION;
+  header.byteOrder_ = BINARY_TABLE_BYTE_ORDER;
+  header.flags_ = (data.usesMixingBijections_) ? BINARY_TABLE_FLAG_MIXING : 0;
+  if (data.xorGranularity_ == TableGranularity::BYTE)
+    header.flags_ |= BINARY_TABLE_FLAG_BYTE_XOR_TABLES;
+  if (data.usesPlainXorTables_)
+    header.flags_ |= BINARY_TABLE_FLAG_PLAIN_XOR_TABLES;
+  header.numSections_ = BINARY_TABLE_SECTIONS;
+  header.dataOffset_ = BINARY_TABLE_DATA_OFFSET;
+  header.sections_ = table_sections(data.usesMixingBijections_);
+  header.dataSize_ = stored_data_size(header.sections_);
+
+  // Only the sections are copied from data; everything in between (flags,
+  // padding) is written as zeros, and the derived tables after the last
+  // section are left out
+  std::vector<uint8_t> file(header.dataOffset_ + header.dataSize_, 0);
+  const auto *image = reinterpret_cast<const uint8_t *>(&data);
+  for (const auto &section : header.sections_) {
+    std::copy_n(image + (section.offset_ - header.dataOffset_), section.size_,
+                file.begin() + section.offset_);
+  }
+  header.checksum_ = sections_checksum(file.data(), header.sections_);
+  std::memcpy(file.data(), &header, sizeof(header));
+
+  o.write(reinterpret_cast<const char *>(file.data()), file.size());
+  return o.good();
+}
+
+bool is_binary_table_file(const std::string &path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::array<char, 8> magic{};
+  ifs.read(magic.data(), magic.size());
+  return ifs.good() && magic == BINARY_TABLE_MAGIC;
+}
+
+WhiteBoxDataPtr map_binary_table(const std::string &path, bool huge_pages) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open white box table file" << std::endl;
+    return nullptr;
+  }
+
+  struct stat file_stat {};
+  BinaryTableHeader header{};
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(header) ||
+      !read_file(fd, &header, sizeof(header))) {
+    std::cerr << "Binary table file is truncated" << std::endl;
+    close(fd);
+    return nullptr;
+  }
+  auto file_size = static_cast<size_t>(file_stat.st_size);
+  if (!check_header(header)) {
+    close(fd);
+    return nullptr;
+  }
+  if (header.version_ == LEGACY_BINARY_TABLE_VERSION) {
+    WhiteBoxDataPtr data = load_legacy_table(fd, header, file_size, huge_pages);
+    close(fd);
+    return data;
+  }
+  if (!check_layout(header, file_size)) {
+    close(fd);
+    return nullptr;
+  }
+
+  // The file holds WhiteBoxData only up to its last stored section. The
+  // mapping covers all of it; the rest is anonymous memory, which takes no
+  // space unless the packed or byte tables are derived into it.
+  size_t stored_size = header.dataOffset_ + header.dataSize_;
+  size_t mapping_size = header.dataOffset_ + sizeof(WhiteBoxData);
+  void *mapping = nullptr;
+  if (huge_pages) {
+    mapping = map_huge_pages(mapping_size, &mapping_size);
+    if (mapping != nullptr && !read_file(fd, mapping, stored_size)) {
+      munmap(mapping, mapping_size);
+      mapping = nullptr;
+    }
+  } else {
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    // Private and writable: applying encodings or packing the XOR tables
+    // copies the touched pages instead of writing through to the file
+    if (mapping != MAP_FAILED &&
+        mmap(mapping, stored_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      munmap(mapping, mapping_size);
+      mapping = MAP_FAILED;
+    }
+    if (mapping == MAP_FAILED) mapping = nullptr;
+  }
+  close(fd);
+  if (mapping == nullptr) {
+    std::cerr << "Could not map white box table file" << std::endl;
+    return nullptr;
+  }
+
+  WhiteBoxDataDeleter deleter;
+  deleter.mapping_ = mapping;
+  deleter.mappingSize_ = mapping_size;
+
+  if (!check_checksum(header, static_cast<const uint8_t *>(mapping))) {
+    deleter(nullptr);
+    return nullptr;
+  }
+
+  // Default initialization leaves the tables as they were read, and sets
+  // up the members that are not stored
+  auto *data = new (static_cast<uint8_t *>(mapping) + header.dataOffset_)
+      WhiteBoxData;
+  data->usesMixingBijections_ = (header.flags_ & BINARY_TABLE_FLAG_MIXING) != 0;
+  data->usesPlainXorTables_ =
+      (header.flags_ & BINARY_TABLE_FLAG_PLAIN_XOR_TABLES) != 0;
+  if ((header.flags_ & BINARY_TABLE_FLAG_BYTE_XOR_TABLES) != 0)
+    data->widenXorTables();
+
+  return WhiteBoxDataPtr(data, deleter);
+}
+
+bool warm(const WhiteBoxData &data, const WarmOptions &options) {
+  const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  int lock_error = 0;
+
+  for (const auto &section : interpreter_sections(data)) {
+    // Reading one byte per page is enough to fault it in; the sum keeps
+    // the reads from being optimized away
+    const auto *bytes = static_cast<const volatile uint8_t *>(section.first);
+    uint8_t sum = 0;
+    for (size_t offset = 0; offset < section.second; offset += page_size)
+      sum = static_cast<uint8_t>(sum + bytes[offset]);
+    sum = static_cast<uint8_t>(sum + bytes[section.second - 1]);
+    (void)sum;
+
+    if (options.lock_ && mlock(section.first, section.second) != 0)
+      lock_error = errno;
+  }
+  if (lock_error != 0)
+    std::cerr << "Could not lock white box tables into memory: "
+              << std::strerror(lock_error) << std::endl;
+
+  if (options.dummyBlocks_ > 0) {
+    if (options.pool_ != nullptr)
+      options.pool_->runOnEachThread(
+          [&](size_t) { run_dummy_blocks(data, options.dummyBlocks_); });
+    else
+      run_dummy_blocks(data, options.dummyBlocks_);
+  }
+
+  return lock_error == 0;
+}
+}  // namespace WhiteBox
@@ -3,43 +3,66 @@
 //
 
 #include <WhiteBoxTableGenerator.h>
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
-#include <NTL/GF2X.h>
-#include <NTL/vec_GF2.h>
-
 #include <RandomPermutation.h>
 
 namespace WhiteBox {
   WhiteBoxTableGenerator::WhiteBoxTableGenerator(
       std::array<uint8_t, AES_KEY_LENGTH_BYTES> aes_key,
-      bool use_internal_encoding, bool use_mixing_bijections)
-      : aesKey_(aes_key), usesMixingBijections_(use_mixing_bijections) {
+      bool use_internal_encoding, bool use_mixing_bijections,
+      TableDirection direction, ThreadPool *pool, TableGranularity granularity)
+      : aesKey_(aes_key), usesInternalEncodings_(use_internal_encoding),
+        usesMixingBijections_(use_mixing_bijections),
+        granularity_(granularity), pool_(pool) {
+    if (direction != TableDirection::DECRYPTION) directions_.push_back(false);
+    if (direction != TableDirection::ENCRYPTION) directions_.push_back(true);
+    const size_t num_directions = directions_.size();
+
     // Calculate round keys
     expandedAesKey_ = aes_key_schedule(aesKey_);
 
-    // Encryption
-    // Calculate T-Boxes and Tyi Tables
-    TBoxes intermediateTBoxes = calculateTBoxes();
-    calculateTyiTables(intermediateTBoxes);
-    calculateXorTables(&xorTables_);
-
-    // Decryption
-    intermediateTBoxes = calculateTBoxesDecryption();
-    calculateTyiTablesDecryption(intermediateTBoxes);
-    calculateXorTables(&xorTablesDecryption_);
+    // Calculate T-Boxes, then Tyi and XOR tables of the requested directions
+    TBoxes intermediateTBoxes{};
+    TBoxes intermediateTBoxesDecryption{};
+    if (hasDirection(false)) intermediateTBoxes = calculateTBoxes();
+    if (hasDirection(true))
+      intermediateTBoxesDecryption = calculateTBoxesDecryption();
+
+    runTasks(2 * num_directions, [&](size_t task) {
+      const bool decryption = directions_[task % num_directions];
+      if (task < num_directions) {
+        if (!decryption)
+          calculateTyiTables(intermediateTBoxes);
+        else
+          calculateTyiTablesDecryption(intermediateTBoxesDecryption);
+      } else {
+        calculateXorTables((decryption) ? &xorTablesDecryption_ : &xorTables_);
+      }
+    });
 
     if (use_mixing_bijections) {
       calculateMixingBijections();
     }
 
     if (use_internal_encoding) {
-      if (use_mixing_bijections) {
-        calculateInternalEncodingsWithMixingBijections();
-      } else {
-        calculateInternalEncodings();
-      }
+      calculateInternalEncodings();
+    }
+  }
+
+  bool WhiteBoxTableGenerator::hasDirection(bool decryption) const {
+    return std::find(directions_.begin(), directions_.end(), decryption) !=
+           directions_.end();
+  }
+
+  void WhiteBoxTableGenerator::runTasks(
+      size_t num_tasks, const std::function<void(size_t)> &task) {
+    if (pool_ != nullptr) {
+      pool_->parallelFor(num_tasks, task);
+    } else {
+      for (size_t i = 0; i < num_tasks; ++i) task(i);
     }
   }
 
@@ -158,54 +181,71 @@ namespace WhiteBox {
   }
 
   void WhiteBoxTableGenerator::calculateMixingBijections() {
-    std::vector<MixingBijection<uint8_t>> bijections_8;
-    std::vector<MixingBijection<uint8_t>> bijections_8_dec;
-    std::vector<MixingBijection<uint32_t>> bijections_32;
-    std::vector<MixingBijection<uint32_t>> bijections_32_dec;
-    std::vector<MixingBijection<uint32_t>> bijections_8_concat;
-    std::vector<MixingBijection<uint32_t>> bijections_8_concat_dec;
-
-    calculateXorTables(&mixingXorTables_);
-    calculateXorTables(&mixingXorTablesDecryption_);
+    // Bijections of the generated directions, drawn up front as the random
+    // source is not thread safe
+    std::array<RoundMixingBijections, NUM_ROUNDS_AES_128 - 1> bijections;
+    std::array<RoundMixingBijections, NUM_ROUNDS_AES_128 - 1> bijections_dec;
+    const size_t num_directions = directions_.size();
 
     for (uint32_t i = 0; i < 9; ++i) {
-      bijections_32.clear();
-      bijections_32_dec.clear();
-      for (uint32_t j = 0; j < 4; ++j) {
-        bijections_32.emplace_back(rng);
-        bijections_32_dec.emplace_back(rng);
-      }
-
-      mixTyiTables(i, bijections_8, bijections_32, i != 0);
-      mixTyiTablesDecryption(i, bijections_8_dec, bijections_32_dec, i != 0);
+      if (hasDirection(false)) drawRoundMixingBijections(&bijections[i]);
+      if (hasDirection(true)) drawRoundMixingBijections(&bijections_dec[i]);
+    }
 
-      bijections_8.clear();
-      bijections_8_dec.clear();
-      for (uint32_t j = 0; j < 16; ++j) {
-        bijections_8.emplace_back(rng);
-        bijections_8_dec.emplace_back(rng);
-      }
-      bijections_8_concat.clear();
-      bijections_8_concat_dec.clear();
-      for (uint32_t j = 0; j < 16; j += 4) {
-        MixingBijection<uint32_t> mb_concat =
-            concatenateBijections(bijections_8[j + 3], bijections_8[j + 2],
-                                  bijections_8[j + 1], bijections_8[j]);
-        MixingBijection<uint32_t> mb_concat_dec = concatenateBijections(
-            bijections_8_dec[j + 3], bijections_8_dec[j + 2],
-            bijections_8_dec[j + 1], bijections_8_dec[j]);
-        bijections_8_concat.push_back(mb_concat);
-        bijections_8_concat_dec.push_back(mb_concat_dec);
-      }
+    // Every round of every direction only writes its own tables; the input
+    // of round i is mixed with the output bijections of round i - 1
+    runTasks((9 + 1) * num_directions, [&](size_t task) {
+      const bool decryption = directions_[task % num_directions];
+      const auto &direction = (decryption) ? bijections_dec : bijections;
+
+      if (task >= 9 * num_directions) {
+        calculateXorTables((decryption) ? &mixingXorTablesDecryption_
+                                        : &mixingXorTables_);
+        return;
+      }
+
+      const size_t round = task / num_directions;
+      const std::vector<MixingBijection<uint8_t>> &input_bijections_8 =
+          direction[(round != 0) ? round - 1 : 0].bijections8_;
+      const RoundMixingBijections &round_bijections = direction[round];
+
+      if (!decryption) {
+        mixTyiTables(round, input_bijections_8, round_bijections.bijections32_,
+                     round != 0);
+        calculateMixingTables(&mixingTables_, round,
+                              round_bijections.bijections32_,
+                              round_bijections.bijections8Concat_, true);
+      } else {
+        mixTyiTablesDecryption(round, input_bijections_8,
+                               round_bijections.bijections32_, round != 0);
+        calculateMixingTables(&mixingTablesDecryption_, round,
+                              round_bijections.bijections32_,
+                              round_bijections.bijections8Concat_, true);
+      }
+    });
+
+    runTasks(num_directions, [&](size_t task) {
+      if (!directions_[task])
+        mixFinalRoundTBoxes(bijections[8].bijections8_);
+      else
+        mixFinalRoundTBoxesDecryption(bijections_dec[8].bijections8_);
+    });
+  }
 
-      calculateMixingTables(&mixingTables_, i, bijections_32, bijections_8_concat,
-                            true);
-      calculateMixingTables(&mixingTablesDecryption_, i, bijections_32_dec,
-                            bijections_8_concat_dec, true);
+  void WhiteBoxTableGenerator::drawRoundMixingBijections(
+      RoundMixingBijections *bijections) {
+    for (uint32_t j = 0; j < 4; ++j) {
+      bijections->bijections32_.emplace_back(rng);
+    }
+    for (uint32_t j = 0; j < 16; ++j) {
+      bijections->bijections8_.emplace_back(rng);
+    }
+    const auto &bijections_8 = bijections->bijections8_;
+    for (uint32_t j = 0; j < 16; j += 4) {
+      bijections->bijections8Concat_.push_back(
+          concatenateBijections(bijections_8[j + 3], bijections_8[j + 2],
+                                bijections_8[j + 1], bijections_8[j]));
     }
-
-    mixFinalRoundTBoxes(bijections_8);
-    mixFinalRoundTBoxesDecryption(bijections_8_dec);
   }
 
   void WhiteBoxTableGenerator::calculateMixingTables(
@@ -217,34 +257,8 @@ namespace WhiteBox {
 
     for (size_t i = 0; i < AES_KEY_LENGTH_BYTES; ++i) {
       for (size_t x = 0; x <= std::numeric_limits<uint8_t>::max(); ++x) {
-        NTL::vec_GF2 v;
-        v.SetLength(32);
-
-        for (size_t j = 0; j < 32; ++j) {
-          v.put(j, 0);
-        }
-
-        if (i % 4 == 3) {
-          for (size_t k = 0; k < 8; ++k) {
-            auto zero_at_pos = static_cast<uint32_t>((x & (1 << k)) != 0);
-            v.put(k, zero_at_pos);
-          }
-        } else if (i % 4 == 2) {
-          for (size_t k = 8; k < 16; ++k) {
-            auto zero_at_pos = static_cast<uint32_t>((x & (1 << (k - 8))) != 0);
-            v.put(k, zero_at_pos);
-          }
-        } else if (i % 4 == 1) {
-          for (size_t k = 16; k < 24; ++k) {
-            auto zero_at_pos = static_cast<uint32_t>((x & (1 << (k - 16))) != 0);
-            v.put(k, zero_at_pos);
-          }
-        } else if (i % 4 == 0) {
-          for (size_t k = 24; k < 32; ++k) {
-            auto zero_at_pos = static_cast<uint32_t>((x & (1 << (k - 24))) != 0);
-            v.put(k, zero_at_pos);
-          }
-        }
+        // Columns are big-endian words, byte 0 is the most significant
+        auto v = static_cast<uint32_t>(x) << (8 * (3 - i % 4));
 
         uint32_t transformed = bijections_32[i / 4].applyInverseTransformation(v);
         if (use_output_mixing_bijections) {
@@ -331,132 +345,93 @@ namespace WhiteBox {
   }
 
   void WhiteBoxTableGenerator::calculateInternalEncodings() {
-    std::vector<RandomPermutation<uint8_t>> tyi_output;
-    std::vector<RandomPermutation<uint8_t>> tyi_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor1_output;
-    std::vector<RandomPermutation<uint8_t>> xor1_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor2_output;
-    std::vector<RandomPermutation<uint8_t>> xor2_output_dec;
+    // Encodings of the generated directions, drawn up front as the random
+    // source is not thread safe
+    std::array<RoundEncodings, NUM_ROUNDS_AES_128 - 1> encodings;
+    std::array<RoundEncodings, NUM_ROUNDS_AES_128 - 1> encodings_dec;
+    const size_t num_directions = directions_.size();
 
     for (size_t i = 0; i < 9; ++i) {
-      // Calculate Tyi output encodings
-      tyi_output.clear();
-      tyi_output_dec.clear();
-      for (size_t j = 0; j < 16 * 8; ++j) {
-        tyi_output.emplace_back(rng, 16);
-        tyi_output_dec.emplace_back(rng, 16);
-      }
-      encodeTyiTables(i, xor2_output, tyi_output, true, i != 0);
-      encodeTyiTablesDecryption(i, xor2_output_dec, tyi_output_dec, true, i != 0);
-
-      // Calculate XOR1 output encodings
-      xor1_output.clear();
-      xor1_output_dec.clear();
-      for (size_t j = 0; j < 8 * 8; ++j) {
-        xor1_output.emplace_back(rng, 16);
-        xor1_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&xorTables_, i, tyi_output, xor1_output, true, false);
-      encodeXorTables(&xorTablesDecryption_, i, tyi_output_dec, xor1_output_dec,
-                      true, false);
-
-      // Calculate XOR2 output encodings
-      xor2_output.clear();
-      xor2_output_dec.clear();
-      for (size_t j = 0; j < 32; ++j) {
-        xor2_output.emplace_back(rng, 16);
-        xor2_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&xorTables_, i, xor1_output, xor2_output, true, true);
-      encodeXorTables(&xorTablesDecryption_, i, xor1_output_dec, xor2_output_dec,
-                      true, true);
+      if (hasDirection(false)) drawRoundEncodings(&encodings[i]);
+      if (hasDirection(true)) drawRoundEncodings(&encodings_dec[i]);
     }
 
-    encodeFinalTBoxes(xor2_output);
-    encodeFinalTBoxesDecryption(xor2_output_dec);
+    // The input encoding of round i is the output encoding of round i - 1;
+    // the first round has no input encoding
+    runTasks(9 * num_directions, [&](size_t task) {
+      const size_t round = task / num_directions;
+      const bool decryption = directions_[task % num_directions];
+      const auto &direction = (decryption) ? encodings_dec : encodings;
+      encodeRound(round, decryption,
+                  direction[(round != 0) ? round - 1 : 0].output(),
+                  direction[round]);
+    });
+
+    runTasks(num_directions, [&](size_t task) {
+      if (!directions_[task])
+        encodeFinalTBoxes(encodings[8].output());
+      else
+        encodeFinalTBoxesDecryption(encodings_dec[8].output());
+    });
   }
 
-  void WhiteBoxTableGenerator::calculateInternalEncodingsWithMixingBijections() {
-    std::vector<RandomPermutation<uint8_t>> tyi_output;
-    std::vector<RandomPermutation<uint8_t>> xor1_output;
-    std::vector<RandomPermutation<uint8_t>> xor2_output;
-    std::vector<RandomPermutation<uint8_t>> mixing_table_output;
-    std::vector<RandomPermutation<uint8_t>> xor3_output;
-    std::vector<RandomPermutation<uint8_t>> xor4_output;
-    std::vector<RandomPermutation<uint8_t>> tyi_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor1_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor2_output_dec;
-    std::vector<RandomPermutation<uint8_t>> mixing_table_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor3_output_dec;
-    std::vector<RandomPermutation<uint8_t>> xor4_output_dec;
+  void WhiteBoxTableGenerator::drawRoundEncodings(RoundEncodings *encodings) {
+    for (size_t j = 0; j < 16 * 8; ++j) {
+      encodings->tyiOutput_.emplace_back(rng, 16);
+    }
+    for (size_t j = 0; j < 8 * 8; ++j) {
+      encodings->xor1Output_.emplace_back(rng, 16);
+    }
+    for (size_t j = 0; j < 32; ++j) {
+      encodings->xor2Output_.emplace_back(rng, 16);
+    }
 
-    for (size_t i = 0; i < 9; ++i) {
-      // Calculate Tyi output encodings
-      tyi_output.clear();
-      tyi_output_dec.clear();
-      for (size_t j = 0; j < 16 * 8; ++j) {
-        tyi_output.emplace_back(rng, 16);
-        tyi_output_dec.emplace_back(rng, 16);
-      }
-      encodeTyiTables(i, xor4_output, tyi_output, true, i != 0);
-      encodeTyiTablesDecryption(i, xor4_output_dec, tyi_output_dec, true, i != 0);
-
-      // Calculate XOR1 output encodings
-      xor1_output.clear();
-      xor1_output_dec.clear();
-      for (size_t j = 0; j < 8 * 8; ++j) {
-        xor1_output.emplace_back(rng, 16);
-        xor1_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&xorTables_, i, tyi_output, xor1_output, true, false);
-      encodeXorTables(&xorTablesDecryption_, i, tyi_output_dec, xor1_output_dec,
-                      true, false);
-
-      // Calculate XOR2 output encodings
-      xor2_output.clear();
-      xor2_output_dec.clear();
-      for (size_t j = 0; j < 32; ++j) {
-        xor2_output.emplace_back(rng, 16);
-        xor2_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&xorTables_, i, xor1_output, xor2_output, true, true);
-      encodeXorTables(&xorTablesDecryption_, i, xor1_output_dec, xor2_output_dec,
-                      true, true);
-
-      mixing_table_output.clear();
-      mixing_table_output_dec.clear();
-      for (size_t j = 0; j < 16 * 8; ++j) {
-        mixing_table_output.emplace_back(rng, 16);
-        mixing_table_output_dec.emplace_back(rng, 16);
-      }
-      encodeMixingTables(i, xor2_output, mixing_table_output, true);
-      encodeMixingTablesDecryption(i, xor2_output_dec, mixing_table_output_dec,
-                                   true);
-
-      xor3_output.clear();
-      xor3_output_dec.clear();
-      for (size_t j = 0; j < 8 * 8; ++j) {
-        xor3_output.emplace_back(rng, 16);
-        xor3_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&mixingXorTables_, i, mixing_table_output, xor3_output,
-                      true, false);
-      encodeXorTables(&mixingXorTablesDecryption_, i, mixing_table_output_dec,
-                      xor3_output_dec, true, false);
-
-      xor4_output.clear();
-      xor4_output_dec.clear();
-      for (size_t j = 0; j < 32; ++j) {
-        xor4_output.emplace_back(rng, 16);
-        xor4_output_dec.emplace_back(rng, 16);
-      }
-      encodeXorTables(&mixingXorTables_, i, xor3_output, xor4_output, true, true);
-      encodeXorTables(&mixingXorTablesDecryption_, i, xor3_output_dec,
-                      xor4_output_dec, true, true);
+    if (!usesMixingBijections_) return;
+
+    for (size_t j = 0; j < 16 * 8; ++j) {
+      encodings->mixingTableOutput_.emplace_back(rng, 16);
+    }
+    for (size_t j = 0; j < 8 * 8; ++j) {
+      encodings->xor3Output_.emplace_back(rng, 16);
+    }
+    for (size_t j = 0; j < 32; ++j) {
+      encodings->xor4Output_.emplace_back(rng, 16);
     }
+  }
 
-    encodeFinalTBoxes(xor4_output);
-    encodeFinalTBoxesDecryption(xor4_output_dec);
+  void WhiteBoxTableGenerator::encodeRound(
+      size_t round, bool decryption,
+      const std::vector<RandomPermutation<uint8_t>> &input_encodings,
+      const RoundEncodings &encodings) {
+    XorTables *xor_tables = (decryption) ? &xorTablesDecryption_ : &xorTables_;
+    XorTables *mixing_xor_tables =
+        (decryption) ? &mixingXorTablesDecryption_ : &mixingXorTables_;
+
+    if (!decryption)
+      encodeTyiTables(round, input_encodings, encodings.tyiOutput_, true,
+                      round != 0);
+    else
+      encodeTyiTablesDecryption(round, input_encodings, encodings.tyiOutput_,
+                                true, round != 0);
+
+    encodeXorTables(xor_tables, round, encodings.tyiOutput_,
+                    encodings.xor1Output_, true, false);
+    encodeXorTables(xor_tables, round, encodings.xor1Output_,
+                    encodings.xor2Output_, true, true);
+
+    if (!usesMixingBijections_) return;
+
+    if (!decryption)
+      encodeMixingTables(round, encodings.xor2Output_,
+                         encodings.mixingTableOutput_, true);
+    else
+      encodeMixingTablesDecryption(round, encodings.xor2Output_,
+                                   encodings.mixingTableOutput_, true);
+
+    encodeXorTables(mixing_xor_tables, round, encodings.mixingTableOutput_,
+                    encodings.xor3Output_, true, false);
+    encodeXorTables(mixing_xor_tables, round, encodings.xor3Output_,
+                    encodings.xor4Output_, true, true);
   }
 
   void WhiteBoxTableGenerator::encodeXorTables(
@@ -907,6 +882,8 @@ namespace WhiteBox {
   }
 
   WhiteBoxData *WhiteBoxTableGenerator::getEncryptionTable() const {
+    if (!hasDirection(false)) return nullptr;
+
     auto *data = new WhiteBoxData;
 
     // Since array has value semantics, this works
@@ -916,14 +893,20 @@ namespace WhiteBox {
     data->xorTables_ = this->xorTables_;
 
     data->usesMixingBijections_ = this->usesMixingBijections_;
+    data->usesPlainXorTables_ = !this->usesInternalEncodings_;
 
-    data->mixingXorTables_ = this->mixingXorTables_;
-    data->mixingTables_ = this->mixingTables_;
+    if (this->usesMixingBijections_) {
+      data->mixingXorTables_ = this->mixingXorTables_;
+      data->mixingTables_ = this->mixingTables_;
+    }
+    if (granularity_ == TableGranularity::BYTE) data->widenXorTables();
 
     return data;
   }
 
   WhiteBoxData *WhiteBoxTableGenerator::getDecryptionTable() const {
+    if (!hasDirection(true)) return nullptr;
+
     auto *data = new WhiteBoxData;
 
     data->finalRoundTBoxes_ = this->finalRoundTBoxesDecryption_;
@@ -931,9 +914,13 @@ namespace WhiteBox {
     data->xorTables_ = this->xorTablesDecryption_;
 
     data->usesMixingBijections_ = this->usesMixingBijections_;
+    data->usesPlainXorTables_ = !this->usesInternalEncodings_;
 
-    data->mixingXorTables_ = this->mixingXorTablesDecryption_;
-    data->mixingTables_ = this->mixingTablesDecryption_;
+    if (this->usesMixingBijections_) {
+      data->mixingXorTables_ = this->mixingXorTablesDecryption_;
+      data->mixingTables_ = this->mixingTablesDecryption_;
+    }
+    if (granularity_ == TableGranularity::BYTE) data->widenXorTables();
 
     return data;
   }
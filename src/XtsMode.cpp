@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <cryptopp/cryptlib.h>
+
+#include <ParallelModes.h>
+#include <WhiteBoxInterpreter.h>
+#include <XtsMode.h>
+
+namespace WhiteBox {
+namespace {
+// A tweak as a little-endian 128-bit number, low word first
+typedef std::array<uint64_t, 2> Tweak;
+
+Tweak load_tweak(const State &block) {
+  Tweak tweak{};
+  for (size_t i = 0; i < 8; ++i) {
+    tweak[0] |= uint64_t{block[i]} << (8 * i);
+    tweak[1] |= uint64_t{block[8 + i]} << (8 * i);
+  }
+  return tweak;
+}
+
+// XORs the tweak onto a block
+void xor_tweak(const Tweak &tweak, const uint8_t *input, uint8_t *output) {
+  for (size_t i = 0; i < 8; ++i) {
+    output[i] = input[i] ^ static_cast<uint8_t>(tweak[0] >> (8 * i));
+    output[8 + i] = input[8 + i] ^ static_cast<uint8_t>(tweak[1] >> (8 * i));
+  }
+}
+
+// Multiplies the tweak by x in GF(2^128), reducing by
+// x^128 + x^7 + x^2 + x + 1: a shift over both words
+void multiply_tweak(Tweak &tweak) {
+  uint64_t carry = tweak[1] >> 63U;
+  tweak[1] = (tweak[1] << 1U) | (tweak[0] >> 63U);
+  tweak[0] = (tweak[0] << 1U) ^ (carry * 0x87U);
+}
+
+// One block of XTS: tweak ^ AES(block ^ tweak)
+State process_block(const WhiteBoxData &data, const Tweak &tweak,
+                    const uint8_t *block, bool decrypt) {
+  State state;
+  xor_tweak(tweak, block, state.data());
+  state = interpret_white_box(data, state, decrypt);
+  xor_tweak(tweak, state.data(), state.data());
+  return state;
+}
+
+void process_sector(const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                    uint64_t sector, const uint8_t *input, uint8_t *output,
+                    size_t length, bool decrypt) {
+  State sector_block{};
+  for (size_t i = 0; i < 8; ++i)
+    sector_block[i] = static_cast<uint8_t>(sector >> (8 * i));
+  Tweak tweak =
+      load_tweak(interpret_white_box(tweak_data, sector_block, false));
+
+  // With a partial last block, the last full block is part of the
+  // ciphertext stealing below
+  size_t remainder = length % AES_BLOCK_SIZE_BYTES;
+  size_t blocks = length / AES_BLOCK_SIZE_BYTES - (remainder != 0 ? 1 : 0);
+
+  // The tweaks of a batch are kept, to be XORed on again after the batch
+  // has run through the white box
+  std::array<Tweak, INTERPRETER_STAGING_BLOCKS> tweaks;
+  std::array<State, INTERPRETER_STAGING_BLOCKS> states;
+  for (size_t i = 0; i < blocks; i += INTERPRETER_STAGING_BLOCKS) {
+    size_t n = std::min(INTERPRETER_STAGING_BLOCKS, blocks - i);
+    const uint8_t *in = input + i * AES_BLOCK_SIZE_BYTES;
+    uint8_t *out = output + i * AES_BLOCK_SIZE_BYTES;
+    for (size_t k = 0; k < n; ++k) {
+      tweaks[k] = tweak;
+      xor_tweak(tweak, in + k * AES_BLOCK_SIZE_BYTES, states[k].data());
+      multiply_tweak(tweak);
+    }
+    interpret_white_box_batch(data, states.data(), states.data(), n, decrypt);
+    for (size_t k = 0; k < n; ++k)
+      xor_tweak(tweaks[k], states[k].data(), out + k * AES_BLOCK_SIZE_BYTES);
+  }
+  if (remainder == 0) return;
+
+  // Ciphertext stealing: the last full block is processed with the tweak
+  // after the one of its position when decrypting, and the first bytes of
+  // its result become the partial block
+  const size_t offset = blocks * AES_BLOCK_SIZE_BYTES;
+  Tweak next_tweak = tweak;
+  multiply_tweak(next_tweak);
+  State stolen = process_block(data, decrypt ? next_tweak : tweak,
+                               input + offset, decrypt);
+  // The partial block is read before output overwrites it
+  std::copy_n(input + offset + AES_BLOCK_SIZE_BYTES, remainder,
+              states[0].begin());
+  std::copy_n(stolen.begin(), remainder,
+              output + offset + AES_BLOCK_SIZE_BYTES);
+  std::copy_n(states[0].begin(), remainder, stolen.begin());
+  State last =
+      process_block(data, decrypt ? tweak : next_tweak, stolen.data(), decrypt);
+  std::copy(last.begin(), last.end(), output + offset);
+}
+
+void process_sectors(const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                     uint64_t first_sector, size_t sector_size,
+                     const uint8_t *input, uint8_t *output, size_t length,
+                     bool decrypt, ThreadPool *pool) {
+  if (sector_size < AES_BLOCK_SIZE_BYTES)
+    throw CryptoPP::InvalidArgument("XTS: sector size is less than a block");
+  if (length == 0) return;
+  if (length % sector_size != 0 &&
+      length % sector_size < AES_BLOCK_SIZE_BYTES)
+    throw CryptoPP::InvalidArgument(
+        "XTS: last sector is shorter than a block");
+
+  // Each task gets about a parallel chunk of whole sectors
+  size_t num_sectors = (length + sector_size - 1) / sector_size;
+  size_t sectors_per_task =
+      std::max<size_t>(1, PARALLEL_CHUNK_SIZE / sector_size);
+  size_t num_tasks = (num_sectors + sectors_per_task - 1) / sectors_per_task;
+
+  auto task = [&](size_t t) {
+    size_t end = std::min(num_sectors, (t + 1) * sectors_per_task);
+    for (size_t s = t * sectors_per_task; s < end; ++s) {
+      size_t begin = s * sector_size;
+      process_sector(data, tweak_data, first_sector + s, input + begin,
+                     output + begin, std::min(sector_size, length - begin),
+                     decrypt);
+    }
+  };
+  if (pool != nullptr && num_tasks > 1) {
+    pool->parallelFor(num_tasks, task);
+  } else {
+    for (size_t t = 0; t < num_tasks; ++t) task(t);
+  }
+}
+
+void process_xts_stream(std::istream &input_stream,
+                        std::ostream &output_stream, const WhiteBoxData &data,
+                        const WhiteBoxData &tweak_data, uint64_t first_sector,
+                        size_t sector_size, bool decrypt, ThreadPool *pool) {
+  if (sector_size < AES_BLOCK_SIZE_BYTES)
+    throw CryptoPP::InvalidArgument("XTS: sector size is less than a block");
+
+  // Windows of whole sectors, about as large as those of the parallel CTR
+  // mode
+  size_t threads = (pool != nullptr) ? pool->numThreads() : 1;
+  size_t sectors_per_window = std::max<size_t>(
+      1, PARALLEL_CHUNK_SIZE * PARALLEL_CHUNKS_PER_THREAD * threads /
+             sector_size);
+  std::vector<uint8_t> buffer(sectors_per_window * sector_size);
+  uint64_t sector = first_sector;
+
+  while (input_stream) {
+    input_stream.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    auto length = static_cast<size_t>(input_stream.gcount());
+    if (length == 0) break;
+    process_sectors(data, tweak_data, sector, sector_size, buffer.data(),
+                    buffer.data(), length, decrypt, pool);
+    output_stream.write(reinterpret_cast<const char *>(buffer.data()), length);
+    sector += sectors_per_window;
+  }
+}
+}  // namespace
+
+void encrypt_xts_sectors(const WhiteBoxData &data,
+                         const WhiteBoxData &tweak_data, uint64_t first_sector,
+                         size_t sector_size, const uint8_t *input,
+                         uint8_t *output, size_t length, ThreadPool *pool) {
+  process_sectors(data, tweak_data, first_sector, sector_size, input, output,
+                  length, false, pool);
+}
+
+void decrypt_xts_sectors(const WhiteBoxData &data,
+                         const WhiteBoxData &tweak_data, uint64_t first_sector,
+                         size_t sector_size, const uint8_t *input,
+                         uint8_t *output, size_t length, ThreadPool *pool) {
+  process_sectors(data, tweak_data, first_sector, sector_size, input, output,
+                  length, true, pool);
+}
+
+void encrypt_xts_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                      uint64_t first_sector, size_t sector_size,
+                      ThreadPool *pool) {
+  process_xts_stream(input_stream, output_stream, data, tweak_data,
+                     first_sector, sector_size, false, pool);
+}
+
+void decrypt_xts_mode(std::istream &input_stream, std::ostream &output_stream,
+                      const WhiteBoxData &data, const WhiteBoxData &tweak_data,
+                      uint64_t first_sector, size_t sector_size,
+                      ThreadPool *pool) {
+  process_xts_stream(input_stream, output_stream, data, tweak_data,
+                     first_sector, sector_size, true, pool);
+}
+}  // namespace WhiteBox